@@ -1,3 +1,8 @@
+newoption({
+    trigger = "trace",
+    description = "Keep TRACE_ZONE instrumentation in Release builds"
+})
+
 workspace("Shader_Livecode")
     configurations({ "Debug", "Release" })
     location("build")
@@ -19,7 +24,7 @@ project("Main")
     kind("ConsoleApp")
     language("C++")
     targetname("livecode")
-    links({"dl", "GL", "SDL2", "imgui", "lua"})
+    links({"dl", "pthread", "GL", "EGL", "SDL2", "imgui", "lua"})
     buildoptions({"-fPIC", "-fmax-errors=5", "-std=c++17", "-Wshadow", "-Wno-literal-suffix", "-fdiagnostics-color=always"})
 
     files({
@@ -33,4 +38,7 @@ project("Main")
     filter("configurations:Release")
         optimize("On")
 
+    filter("options:trace")
+        defines({"STORMY_TRACE"})
+
     filter {}
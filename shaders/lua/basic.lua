@@ -2,6 +2,9 @@ local frag_name = "025"
 
 function render()
     target_fps(r, 30)
+
+    -- everything up to gl_submit_batch is recorded and sent to GL in one go
+    gl_begin_batch(r)
     gl_clear_color(r)
     gl_disable_alpha_blend(r)
     gl_default_viewport(r)
@@ -15,4 +18,5 @@ function render()
     gl_use_shader(r, shader)
     gl_set_default_uniforms(r)
     gl_draw_quad(r)
+    gl_submit_batch(r)
 end
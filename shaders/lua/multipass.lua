@@ -0,0 +1,24 @@
+local frag_name = "025"
+
+function render()
+    target_fps(r, 60)
+    gl_clear_color(r)
+    gl_disable_alpha_blend(r)
+    gl_default_viewport(r)
+    gl_default_fb(r)
+    gl_enable_srgb(r)
+
+    local vert = gl_load_shader_part(r, "quad", GL_VERTEX, "vertex/one_quad.vertex_shader")
+    local frag = gl_load_shader_part(r, "main frag", GL_FRAGMENT, "fragment/" .. find_file_that_starts_with_in_folder(r, frag_name, "fragment/"))
+    local upsample_frag = gl_load_shader_part(r, "upsample frag", GL_FRAGMENT, "fragment/026_upsample.fragment_shader")
+
+    local shader = gl_load_shader(r, "main shader", {vert, frag})
+    local upsample = gl_load_shader(r, "upsample shader", {vert, upsample_frag})
+
+    -- the expensive shader runs at a quarter of the pixels, the upsample pass stretches it over the window
+    local low_res = gl_render_target(r, "low res", { scale = 0.5, format = "rgba16f", transient = true })
+
+    gl_pass(r, "main", shader, low_res, {})
+    gl_pass(r, "upsample", upsample, nil, { iChannel0 = low_res })
+    gl_run_passes(r)
+end
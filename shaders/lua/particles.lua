@@ -5,9 +5,15 @@ function render_background()
     local frag = gl_load_shader_part(r, "alpha checker frag", GL_FRAGMENT, "fragment/008_alpha_checkers.fragment_shader")
     local shader = gl_load_shader(r, "alpha checkers shader", {vert, frag})
 
-    gl_use_shader(r, shader)
-    gl_set_default_uniforms(r)
-    gl_draw_quad(r)
+    local upsample_frag = gl_load_shader_part(r, "upsample frag", GL_FRAGMENT, "fragment/026_upsample.fragment_shader")
+    local upsample = gl_load_shader(r, "upsample shader", {vert, upsample_frag})
+
+    -- the checkers only depend on the resolution, so they're only drawn again after a resize
+    local checkers = gl_render_target(r, "alpha checkers", { format = "srgb8" })
+
+    gl_pass(r, "alpha checkers", shader, checkers, {})
+    gl_pass(r, "background", upsample, nil, { iChannel0 = checkers })
+    gl_run_passes(r)
 end
 
 function render_shader()
@@ -5,6 +5,9 @@ extern "C" {
     #undef ARRAY_SIZE // NOTE(justas): gl3w defines this
     
     #include <GL/gl.h>
+
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
 }
 
 //#include "external/sol/forward.hpp"
@@ -13,22 +16,278 @@ extern "C" {
 #include "stormy.cpp"
 #include "SDL2/SDL.h"
 #include <chrono>
+#include <signal.h>
+#include <poll.h>
+#include <sys/inotify.h>
 #include "imgui.h"
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_opengl3.h"
 
-intern auto base_untracked_malloc_allocator = make_malloc_memory_allocator();
-intern auto malloc_allocator = make_tracked_memory_allocator(&base_untracked_malloc_allocator);
+// NOTE(justas): the uniform names, errors and hash arrays a shader reload churns through are
+// tiny, so they come out of size classes instead of malloc. The pool isn't thread safe, only
+// ever allocate from it or free into it on the main thread. Anything shared with another
+// thread goes on malloc_allocator.
+//
+// Pools reserve address space up front for their slabs, 256MB of small allocations is far
+// more than a session of shader reloads gets near. Bigger allocations don't count towards it.
+#define MAIN_THREAD_POOL_RESERVE_SIZE MEGABYTES((s64)256)
+
+intern auto main_thread_allocator = make_pool_memory_allocator(KILOBYTES(64), MAIN_THREAD_POOL_RESERVE_SIZE);
+intern auto malloc_allocator = make_malloc_memory_allocator();
+
+// NOTE(justas): our shadow of the GL bindings and toggles we change while rendering. Setting
+// one to what it already is never reaches the driver. Everything in here has to go through
+// gl_state_* for that to hold, imgui puts back whatever it touches so it doesn't get in the
+// way. -1 means we don't know and the next call goes through.
+#define MAX_GL_STATE_TEXTURE_UNITS 16
+
+enum GL_STATE_ {
+    GL_STATE_PROGRAM,
+    GL_STATE_VERTEX_ARRAY,
+    GL_STATE_ARRAY_BUFFER,
+    GL_STATE_DRAW_FRAMEBUFFER,
+    GL_STATE_READ_FRAMEBUFFER,
+    GL_STATE_VIEWPORT,
+    GL_STATE_BLEND,
+    GL_STATE_BLEND_FUNC,
+    GL_STATE_SRGB,
+    GL_STATE_ACTIVE_TEXTURE,
+    GL_STATE_TEXTURE,
+
+    GL_STATE_COUNT
+};
+
+intern const char * gl_state_names[GL_STATE_COUNT] = {
+    "program",
+    "vertex array",
+    "array buffer",
+    "draw framebuffer",
+    "read framebuffer",
+    "viewport",
+    "blend",
+    "blend func",
+    "srgb",
+    "active texture",
+    "texture",
+};
+
+struct Gl_State_Cache {
+    s64 program;
+    s64 vertex_array;
+    s64 array_buffer;
+    s64 draw_framebuffer;
+    s64 read_framebuffer;
+    s32 viewport[4];
+    s32 blend;
+    s32 srgb;
+    s64 blend_func[4];
+    s64 active_texture;
+    s64 textures[MAX_GL_STATE_TEXTURE_UNITS];
+
+    s64 num_issued[GL_STATE_COUNT];
+    s64 num_skipped[GL_STATE_COUNT];
+
+    // NOTE(justas): the counts of the last whole frame, for the ui.
+    s64 last_frame_issued[GL_STATE_COUNT];
+    s64 last_frame_skipped[GL_STATE_COUNT];
+};
+
+intern Gl_State_Cache gl_state;
+
+intern
+void gl_state_invalidate() {
+    gl_state.program = -1;
+    gl_state.vertex_array = -1;
+    gl_state.array_buffer = -1;
+    gl_state.draw_framebuffer = -1;
+    gl_state.read_framebuffer = -1;
+    gl_state.viewport[0] = gl_state.viewport[1] = gl_state.viewport[2] = gl_state.viewport[3] = -1;
+    gl_state.blend = -1;
+    gl_state.srgb = -1;
+    gl_state.blend_func[0] = gl_state.blend_func[1] = gl_state.blend_func[2] = gl_state.blend_func[3] = -1;
+    gl_state.active_texture = -1;
+
+    ForRange(index, 0, MAX_GL_STATE_TEXTURE_UNITS) {
+        gl_state.textures[index] = -1;
+    }
+}
+
+intern
+void gl_state_end_frame() {
+    ForRange(index, 0, GL_STATE_COUNT) {
+        gl_state.last_frame_issued[index] = gl_state.num_issued[index];
+        gl_state.last_frame_skipped[index] = gl_state.num_skipped[index];
+        gl_state.num_issued[index] = 0;
+        gl_state.num_skipped[index] = 0;
+    }
+}
+
+// NOTE(justas): updates the shadow, true when the call has to go to GL.
+intern force_inline
+b32 gl_state_change(GL_STATE_ kind, s64 * current, s64 value) {
+    if(*current == value) {
+        gl_state.num_skipped[kind]++;
+        return false;
+    }
+
+    *current = value;
+    gl_state.num_issued[kind]++;
+    return true;
+}
+
+intern force_inline
+void gl_state_use_program(u32 id) {
+    if(gl_state_change(GL_STATE_PROGRAM, &gl_state.program, id)) {
+        glUseProgram(id);
+    }
+}
+
+intern force_inline
+void gl_state_bind_vertex_array(u32 id) {
+    if(gl_state_change(GL_STATE_VERTEX_ARRAY, &gl_state.vertex_array, id)) {
+        glBindVertexArray(id);
+    }
+}
+
+intern force_inline
+void gl_state_bind_array_buffer(u32 id) {
+    if(gl_state_change(GL_STATE_ARRAY_BUFFER, &gl_state.array_buffer, id)) {
+        glBindBuffer(GL_ARRAY_BUFFER, id);
+    }
+}
+
+intern
+void gl_state_bind_framebuffer(GLenum target, u32 id) {
+    if(target == GL_FRAMEBUFFER) {
+        if(gl_state.draw_framebuffer == id && gl_state.read_framebuffer == id) {
+            gl_state.num_skipped[GL_STATE_DRAW_FRAMEBUFFER]++;
+            return;
+        }
+
+        gl_state.draw_framebuffer = id;
+        gl_state.read_framebuffer = id;
+        gl_state.num_issued[GL_STATE_DRAW_FRAMEBUFFER]++;
+        glBindFramebuffer(GL_FRAMEBUFFER, id);
+    }
+    else if(target == GL_DRAW_FRAMEBUFFER) {
+        if(gl_state_change(GL_STATE_DRAW_FRAMEBUFFER, &gl_state.draw_framebuffer, id)) {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, id);
+        }
+    }
+    else {
+        assert(target == GL_READ_FRAMEBUFFER);
+        if(gl_state_change(GL_STATE_READ_FRAMEBUFFER, &gl_state.read_framebuffer, id)) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, id);
+        }
+    }
+}
+
+intern
+void gl_state_viewport(s32 x, s32 y, s32 w, s32 h) {
+    auto * v = gl_state.viewport;
+    if(v[0] == x && v[1] == y && v[2] == w && v[3] == h) {
+        gl_state.num_skipped[GL_STATE_VIEWPORT]++;
+        return;
+    }
+
+    v[0] = x; v[1] = y; v[2] = w; v[3] = h;
+    gl_state.num_issued[GL_STATE_VIEWPORT]++;
+    glViewport(x, y, w, h);
+}
+
+intern
+void gl_state_set_toggle(GL_STATE_ kind, s32 * current, GLenum cap, b32 is_enabled) {
+    is_enabled = is_enabled ? 1 : 0;
+    if(*current == is_enabled) {
+        gl_state.num_skipped[kind]++;
+        return;
+    }
+
+    *current = is_enabled;
+    gl_state.num_issued[kind]++;
+
+    if(is_enabled) glEnable(cap);
+    else glDisable(cap);
+}
+
+intern force_inline
+void gl_state_set_blend(b32 is_enabled) {
+    gl_state_set_toggle(GL_STATE_BLEND, &gl_state.blend, GL_BLEND, is_enabled);
+}
+
+intern force_inline
+void gl_state_set_srgb(b32 is_enabled) {
+    gl_state_set_toggle(GL_STATE_SRGB, &gl_state.srgb, GL_FRAMEBUFFER_SRGB, is_enabled);
+}
+
+intern
+void gl_state_blend_func_separate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha) {
+    auto * f = gl_state.blend_func;
+    if(f[0] == src_rgb && f[1] == dst_rgb && f[2] == src_alpha && f[3] == dst_alpha) {
+        gl_state.num_skipped[GL_STATE_BLEND_FUNC]++;
+        return;
+    }
+
+    f[0] = src_rgb; f[1] = dst_rgb; f[2] = src_alpha; f[3] = dst_alpha;
+    gl_state.num_issued[GL_STATE_BLEND_FUNC]++;
+    glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+}
+
+intern force_inline
+void gl_state_active_texture(s32 unit) {
+    assert(unit >= 0 && unit < MAX_GL_STATE_TEXTURE_UNITS);
+    if(gl_state_change(GL_STATE_ACTIVE_TEXTURE, &gl_state.active_texture, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+// NOTE(justas): binds to whatever unit is active.
+intern
+void gl_state_bind_texture_2d(u32 id) {
+    if(gl_state.active_texture == -1) {
+        gl_state_active_texture(0);
+    }
+
+    if(gl_state_change(GL_STATE_TEXTURE, &gl_state.textures[gl_state.active_texture], id)) {
+        glBindTexture(GL_TEXTURE_2D, id);
+    }
+}
+
+// NOTE(justas): GL drops bindings to deleted objects and will hand their names out again.
+intern
+void gl_state_forget_texture(u32 id) {
+    ForRange(index, 0, MAX_GL_STATE_TEXTURE_UNITS) {
+        if(gl_state.textures[index] == id) {
+            gl_state.textures[index] = -1;
+        }
+    }
+}
+
+intern
+void gl_state_forget_framebuffer(u32 id) {
+    if(gl_state.draw_framebuffer == id) gl_state.draw_framebuffer = -1;
+    if(gl_state.read_framebuffer == id) gl_state.read_framebuffer = -1;
+}
+
+intern
+void gl_state_forget_program(u32 id) {
+    if(gl_state.program == id) {
+        gl_state.program = -1;
+    }
+}
 
+// NOTE(justas): doesn't wait for the compile to finish, the status is checked
+// with did_shader_part_compile_properly.
 intern
-b32 compile_shader_part(
+b32 submit_shader_part_compile(
         GLenum type, 
         String source,
         String defines,
-        Memory_Allocator * temp_alloc,
         String * out_error,
         u32 * out_id
 ) {
+    TRACE_ZONE("submit_shader_part_compile");
+
     auto id = glCreateShader(type);
 
     if(id == 0) {
@@ -55,37 +314,45 @@ b32 compile_shader_part(
     glShaderSource(id, ARRAY_SIZE(sources), sources, lengths);
     glCompileShader(id);
 
-    {
-        s32 status;
-        glGetShaderiv(id, GL_COMPILE_STATUS, &status);
-
-        if(status != GL_TRUE) {
+    *out_id = id;
+    return true;
+}
 
-            s32 log_length = 0;
-            glGetShaderiv(id, GL_INFO_LOG_LENGTH, &log_length);
+intern
+b32 did_shader_part_compile_properly(
+        u32 id,
+        Memory_Allocator * temp_alloc,
+        String * out_error
+) {
+    s32 status;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &status);
 
-            if(log_length != 0) {
-                *out_error = allocate_temp_string(temp_alloc, log_length, "gl_make_shader log_buffer");
-                glGetShaderInfoLog(id, log_length, &log_length, (char*)out_error->str);
+    if(status == GL_TRUE) {
+        return true;
+    }
 
-            } else {
-                *out_error = "failed to compile shader but no logs were provided."_S;
-            }
+    s32 log_length = 0;
+    glGetShaderiv(id, GL_INFO_LOG_LENGTH, &log_length);
 
-            glDeleteShader(id);
+    if(log_length != 0) {
+        *out_error = allocate_temp_string(temp_alloc, log_length, "gl_make_shader log_buffer");
+        glGetShaderInfoLog(id, log_length, &log_length, (char*)out_error->str);
 
-            return false;
-        }
+    } else {
+        *out_error = "failed to compile shader but no logs were provided."_S;
     }
 
-    *out_id = id;
-    return true;
+    return false;
 }
 
 struct Uniform_Info {
     String name; // NOTE(justas): freeme
     GLenum type;
-    u32 id;
+    s32 location;
+
+    // NOTE(justas): `as` is our shadow of what the program currently holds,
+    // dirty means it was edited on our side and still needs an upload.
+    b32 is_dirty;
 
     union {
         b32 boolean;
@@ -98,12 +365,42 @@ struct Uniform_Info {
 };
 
 intern b32 show_uniform_window = false;
+intern b32 show_profiler_window = false;
 
+// NOTE(justas): parts are keyed by what they compile to (type and source), not by the name the
+// script gave them, so every program that uses the same file shares one GL shader. ref_count
+// is the number of files currently loaded as this part plus the programs linked with it.
 struct Gl_Shader_Part {
     String name = empty_string;
     u64 comparison_hash;
     u32 id = -1;
     String error;
+    s64 ref_count;
+
+    // NOTE(justas): parts only get compiled once a program that uses them
+    // misses the program binary cache, until then we just hold on to the source.
+    GLenum type;
+    b32 is_loaded;
+    u64 source_hash;
+    String source; // NOTE(justas): freeme
+
+    // NOTE(justas): the compile runs in the background, these only get set
+    // once a program that uses this part has finished linking.
+    b32 is_compiled;
+    b32 has_compile_failed;
+};
+
+// NOTE(justas): which per frame values a linked program reads, so a pass drawn with it
+// knows when it has to be redrawn.
+enum FRAME_DEPENDENCY_ {
+    FRAME_DEPENDENCY_TIME = 1 << 0,
+    FRAME_DEPENDENCY_RESOLUTION = 1 << 1,
+    FRAME_DEPENDENCY_MOUSE = 1 << 2,
+};
+
+struct Uniform_Location {
+    s32 location;
+    s32 info_index; // NOTE(justas): into Gl_Shader::uniforms, -1 if not an active uniform
 };
 
 struct Gl_Shader {
@@ -113,26 +410,47 @@ struct Gl_Shader {
     Array<u64> part_hashes;
     Array<Uniform_Info> uniforms;
 
+    // NOTE(justas): a reloaded program that is still compiling/linking. We keep
+    // rendering with `id` until it's done.
+    u32 pending_id = -1;
+    u64 pending_binary_key;
+    Array<u64> pending_parts;
+
+    // NOTE(justas): uniform name hash -> location. Filled in when the program
+    // is linked, lookups for names that aren't active uniforms get cached as -1.
+    Table<Uniform_Location> uniform_locations;
+
+    u32 frame_dependencies;
+
+    // NOTE(justas): bumped for uploads we keep no shadow value of (matrices), render pass keys
+    // hash the shadow values of everything else.
+    u64 untracked_uniform_version;
+
     String error;
 
     Gl_Shader() {
-        part_hashes = make_array<u64>(8, &malloc_allocator, "gl shader part hashes"_S);
-        uniforms = make_array<Uniform_Info>(8, &malloc_allocator, "uniforms"_S);
+        part_hashes = make_array<u64>(8, &main_thread_allocator, "gl shader part hashes"_S);
+        uniforms = make_array<Uniform_Info>(8, &main_thread_allocator, "uniforms"_S);
+        pending_parts = make_array<u64>(8, &main_thread_allocator, "gl shader pending parts"_S);
+        uniform_locations = make_table<Uniform_Location>(16, &main_thread_allocator, "uniform locations"_S);
     }
 
     void clear_uniforms() {
         For(uniforms) {
-            string_free(&malloc_allocator, &it->name);
+            string_free(&main_thread_allocator, &it->name);
         }
 
         array_clear(&uniforms);
+        table_clear(&uniform_locations);
     }
 
     void free() {
         clear_uniforms();
         array_free(&uniforms);
+        table_free(&uniform_locations);
+        array_free(&pending_parts);
         array_free(&part_hashes);
-        string_free(&malloc_allocator, &error);
+        string_free(&main_thread_allocator, &error);
     }
 };
 
@@ -141,24 +459,201 @@ struct Asset_Entry {
     b32 needs_first_load = true;
     u64 last_load_time = 0;
     f64 countdown_to_load = 0;
+
+    // NOTE(justas): of the contents we loaded last time. Saving or touching a file
+    // without changing it, or a git checkout going over it, shouldn't cost us a recompile.
+    b32 has_content_hash = false;
+    u64 content_hash = 0;
+
+    // NOTE(justas): set when the file watcher is tracking this asset, we don't
+    // poll its mtime then.
+    s32 watch = -1;
+    u64 watch_name_hash = 0;
+    b32 has_changed = false;
+};
+
+// NOTE(justas): something a pass can draw into and other passes can sample from. The size is
+// either fixed or a scale of the window size, so scaled targets follow resizes.
+struct Render_Target {
+    String name = empty_string;
+    GLenum format;
+    v2 fixed_size;
+    f32 scale;
+    s32 num_mips;
+
+    // NOTE(justas): transient targets only have to hold their contents for the frame they're
+    // drawn in, so the graph lets targets whose lifetimes don't overlap share a texture.
+    // Persistent ones keep theirs across frames.
+    b32 is_transient;
+
+    // NOTE(justas): into Lua_Renderer::render_textures, picked every time the graph runs.
+    s64 texture_index = -1;
+
+    // NOTE(justas): index of the first pass this frame that touches a transient target.
+    s64 first_use = -1;
+
+    // NOTE(justas): bumped every time a pass draws into this target.
+    u64 version;
+
+    // NOTE(justas): the pass that drew the current contents and the key of everything it
+    // read at that point. If they match next frame the pass is skipped.
+    u64 last_pass_hash;
+    u64 last_pass_key;
+};
+
+struct Render_Texture {
+    u32 texture; // NOTE(justas): 0 means this slot is free
+    u32 fbo;
+    GLenum format;
+    v2_s32 size;
+    s32 num_mips;
+
+    b32 is_persistent;
+    b32 is_used_this_frame;
+
+    // NOTE(justas): unique per texture we create, GL reuses names.
+    u64 generation;
+
+    // NOTE(justas): index of the last pass that touches the transient target living in this
+    // texture, another one can move in after that.
+    s64 last_use;
+
+    // NOTE(justas): the target that last drew into this texture.
+    u64 last_target_hash;
+};
+
+#define MAX_RENDER_PASS_INPUTS 8
+
+struct Render_Pass_Input {
+    u64 target_hash;
+    String uniform; // NOTE(justas): temp, lives until the graph runs
+};
+
+struct Render_Pass {
+    String name; // NOTE(justas): temp
+    u64 name_hash;
+    u64 shader_hash;
+    u64 output_hash; // NOTE(justas): 0 is the default framebuffer
+
+    Render_Pass_Input inputs[MAX_RENDER_PASS_INPUTS];
+    s32 num_inputs;
+
+    b32 is_needed;
+};
+
+// NOTE(justas): between gl_begin_batch and gl_submit_batch the gl_* calls that draw or touch
+// state get recorded here instead of going to GL. On submit they run in the order the script
+// made them, every draw is a full screen quad without depth so reordering would change the
+// picture. Program, blend and srgb changes that wouldn't do anything get dropped. Commands
+// live on the temp allocator, a batch never outlives a frame.
+enum RENDER_COMMAND_ {
+    RENDER_COMMAND_CLEAR_COLOR,
+    RENDER_COMMAND_DEFAULT_FB,
+    RENDER_COMMAND_DEFAULT_VIEWPORT,
+    RENDER_COMMAND_UNIFORM,
+    RENDER_COMMAND_DEFAULT_UNIFORMS,
+    RENDER_COMMAND_DRAW_QUAD,
+};
+
+#define RENDER_STATE_BLEND (1 << 0)
+#define RENDER_STATE_SRGB (1 << 1)
+
+// NOTE(justas): filled in by resolve_render_batch right before the commands run.
+#define RENDER_COMMAND_SWITCH_PROGRAM (1 << 0)
+#define RENDER_COMMAND_DROPPED (1 << 1)
+
+struct Render_Command {
+    RENDER_COMMAND_ type;
+    u64 shader_hash;
+    u32 state;
+    u32 flags;
+
+    // NOTE(justas): RENDER_COMMAND_UNIFORM only.
+    const char * uniform_name;
+    GLenum uniform_type;
+    v2 uniform_value;
+};
+
+struct Render_Batch {
+    b32 is_recording;
+    Array<Render_Command> commands;
+
+    // NOTE(justas): what the script has set up so far and what GL had before the batch.
+    u64 shader_hash;
+    u32 state;
+    u32 executed_state;
+
+    s64 num_commands;
+    s64 num_dropped_commands;
+    s64 num_requested_program_switches;
+    s64 num_program_switches;
+};
+
+// NOTE(justas): the `frame` global scripts read. It sits behind a pointer on the renderer's
+// allocator so the userdata Lua holds stays valid when the renderer gets moved, which lets
+// main fill it in place every frame instead of setting a handful of globals.
+struct Lua_Frame_State {
+    f64 dt;
+    f64 time;
+    f64 resolution_x;
+    f64 resolution_y;
+    s64 index;
 };
 
 struct Lua_Renderer {
     f64 target_fps = 60.0;
 
-    Memory_Allocator alloc;
+    // NOTE(justas): set with dynamic_resolution, the frame gets rendered at a scale in this
+    // range that keeps the gpu inside the target_fps budget.
+    b32 wants_dynamic_resolution;
+    f32 min_resolution_scale;
+    f32 max_resolution_scale;
+
+    // NOTE(justas): the pool has free lists and tables of its own and every container below
+    // points at it, so it lives on the heap where moving the renderer doesn't copy it.
+    Memory_Allocator * alloc;
     Memory_Allocator * temp_alloc;
 
     Table<Asset_Entry> asset_catalogue;
     Table<Gl_Shader_Part> shader_parts;
+
+    // NOTE(justas): file path and type to the part its contents are in right now.
+    Table<u64> shader_part_keys;
+    s64 num_shared_part_loads;
     Table<Gl_Shader> shaders;
 
+    Table<Render_Target> render_targets;
+    Array<Render_Texture> render_textures;
+
+    // NOTE(justas): recorded by gl_pass, cleared once gl_run_passes has drawn them.
+    Array<Render_Pass> render_passes;
+
+    s64 num_drawn_passes;
+    s64 num_cached_passes;
+
+    Render_Batch batch;
+
     sol::state lua;
 
-    Gl_Shader active_shader;
+    // NOTE(justas): looked up once per load, has to be released before lua is.
+    sol::protected_function render_fn;
+    Lua_Frame_State * frame;
+
+    // NOTE(justas): shaders live in a table that moves its storage on growth,
+    // so we only remember which one is bound and look it up when needed.
+    u64 active_shader_hash;
     b32 can_render;
     b32 needs_free;
 
+    force_inline
+    Gl_Shader * get_active_shader() {
+        if(active_shader_hash == 0) {
+            return 0;
+        }
+
+        return table_get(&shaders, active_shader_hash);
+    }
+
     force_inline
     Asset_Entry * get_asset(u64 hash, const char * path) {
         auto * asset = table_insert_or_initialize_new(&asset_catalogue, hash);
@@ -167,16 +662,49 @@ struct Lua_Renderer {
     }
 
     void free() {
+        render_fn = sol::protected_function();
+
         For(shaders) {
+            gl_state_forget_program(it->value.id);
             glDeleteProgram(it->value.id);
+            if(it->value.pending_id != -1) {
+                glDeleteProgram(it->value.pending_id);
+            }
             it->value.free();
         }
 
-        free_tracked_memory_allocator(&alloc);
+        For(shader_parts) {
+            if(it->value.id != -1) {
+                glDeleteShader(it->value.id);
+            }
+            string_free(&main_thread_allocator, &it->value.source);
+        }
+
+        For(render_textures) {
+            if(it->texture != 0) {
+                gl_state_forget_framebuffer(it->fbo);
+                gl_state_forget_texture(it->texture);
+                glDeleteFramebuffers(1, &it->fbo);
+                glDeleteTextures(1, &it->texture);
+            }
+        }
+
+        free_pool_memory_allocator(alloc);
+
+        Memory_Allocation alloc_mem;
+        alloc_mem.data = alloc;
+        alloc_mem.length = sizeof(*alloc);
+        memory_allocator_free(&main_thread_allocator, alloc_mem);
+        alloc = 0;
 
         asset_catalogue = {};
         shader_parts = {};
+        shader_part_keys = {};
         shaders = {};
+        render_targets = {};
+        render_textures = {};
+        render_passes = {};
+        frame = 0;
     }
 };
 
@@ -184,91 +712,171 @@ intern Lua_Renderer renderer;
 intern f64 dt;
 
 intern
-s32 get_uniform_index(
+Uniform_Location * get_uniform_location(
         Gl_Shader * shader,
         const char * loc,
         b32 complain = true
 ) {
-    auto val = glGetUniformLocation(shader->id, loc);
-    if(complain && val == -1) {
+    if(shader->id == -1) {
+        return 0;
+    }
+
+    auto hash = hash_fnv(make_string(loc));
+
+    b32 did_insert = false;
+    auto * cached = table_insert(&shader->uniform_locations, hash, &did_insert);
+    if(did_insert) {
+        cached->location = glGetUniformLocation(shader->id, loc);
+        cached->info_index = -1;
+    }
+
+    if(complain && cached->location == -1) {
         //printf("failed to find uniform '%s' in program '%.*s'\n", loc, shader->name.length, shader->name.str);
     }
 
-    return val;
+    return cached;
+}
+
+intern force_inline
+s32 get_uniform_index(
+        Gl_Shader * shader,
+        const char * loc,
+        b32 complain = true
+) {
+    auto * cached = get_uniform_location(shader, loc, complain);
+    if(!cached) {
+        return -1;
+    }
+
+    return cached->location;
+}
+
+// NOTE(justas): returns the location to upload the value to, or -1 when the
+// upload can be skipped because the uniform isn't there or already holds the value.
+template<typename T>
+intern force_inline
+s32 get_uniform_index_for_write(
+        Gl_Shader * shader,
+        const char * loc,
+        const T & value,
+        b32 complain = true
+) {
+    auto * cached = get_uniform_location(shader, loc, complain);
+    if(!cached || cached->location == -1) {
+        return -1;
+    }
+
+    if(cached->info_index != -1 && sizeof(T) <= sizeof(Uniform_Info::as)) {
+        auto * info = array_get_at_index_unchecked(&shader->uniforms, cached->info_index);
+
+        if(!info->is_dirty && are_bytes_equal((u8*)&info->as, (u8*)&value, sizeof(T))) {
+            return -1;
+        }
+
+        copy_bytes((u8*)&info->as, (u8*)&value, sizeof(T));
+        info->is_dirty = false;
+    }
+    else {
+        shader->untracked_uniform_version++;
+    }
+
+    return cached->location;
 }
 
 intern force_inline
 void set_uniform_f32(Gl_Shader * shader, const char * name, f32 value) {
-    glUniform1f(get_uniform_index(shader, name), value);
+    auto index = get_uniform_index_for_write(shader, name, value);
+    if(index != -1) {
+        glUniform1f(index, value);
+    }
 }
 
 intern force_inline
 void set_uniform_b32(Gl_Shader * shader, const char * name, b32 value) {
-    glUniform1i(get_uniform_index(shader, name), value);
+    auto index = get_uniform_index_for_write(shader, name, value);
+    if(index != -1) {
+        glUniform1i(index, value);
+    }
 }
 
 intern force_inline
-void set_uniform_v2_f32(Gl_Shader * shader, const char * name, v2_f64 value, b32 complain = true) {
-    v2 converted = v2_f64_to_v2_f32(value);
-    glUniform2fv(get_uniform_index(shader, name, complain), 1, (f32*)&converted);
+void set_uniform_v2_f32(Gl_Shader * shader, const char * name, v2 value, b32 complain = true) {
+    auto index = get_uniform_index_for_write(shader, name, value, complain);
+    if(index != -1) {
+        glUniform2fv(index, 1, (f32*)&value);
+    }
 }
 
 intern force_inline
-void set_uniform_v4_f32(Gl_Shader * shader, const char * name, v4_f64 value) {
-    v4 converted = v4_f64_to_v4_f32(value);
-    glUniform4fv(get_uniform_index(shader, name), 1, (f32*)&converted);
+void set_uniform_v2_f32(Gl_Shader * shader, const char * name, v2_f64 value, b32 complain = true) {
+    set_uniform_v2_f32(shader, name, v2_f64_to_v2_f32(value), complain);
 }
 
 intern force_inline
-void set_uniform_v2_s32(Gl_Shader * shader, const char * name, v2_s32 value) {
-    glUniform2iv(get_uniform_index(shader, name), 1, (s32*)&value);
+void set_uniform_v4_f32(Gl_Shader * shader, const char * name, v4 value) {
+    auto index = get_uniform_index_for_write(shader, name, value);
+    if(index != -1) {
+        glUniform4fv(index, 1, (f32*)&value);
+    }
 }
 
 intern force_inline
-void set_uniform_s32(Gl_Shader * shader, const char * name, s32 value) {
-    glUniform1i(get_uniform_index(shader, name), value);
+void set_uniform_v4_f32(Gl_Shader * shader, const char * name, v4_f64 value) {
+    set_uniform_v4_f32(shader, name, v4_f64_to_v4_f32(value));
 }
 
 intern force_inline
-void set_uniform_v2_f32(Gl_Shader * shader, const char * name, v2 value, b32 complain = true) {
-    glUniform2fv(get_uniform_index(shader, name, complain), 1, (f32*)&value);
+void set_uniform_v2_s32(Gl_Shader * shader, const char * name, v2_s32 value) {
+    auto index = get_uniform_index_for_write(shader, name, value);
+    if(index != -1) {
+        glUniform2iv(index, 1, (s32*)&value);
+    }
 }
 
-
 intern force_inline
-void set_uniform_v3_f32(Gl_Shader * shader, const char * name, v3 value) {
-    glUniform3fv(get_uniform_index(shader, name), 1, (f32*)&value);
+void set_uniform_s32(Gl_Shader * shader, const char * name, s32 value) {
+    auto index = get_uniform_index_for_write(shader, name, value);
+    if(index != -1) {
+        glUniform1i(index, value);
+    }
 }
 
 intern force_inline
-void set_uniform_v4_f32(Gl_Shader * shader, const char * name, v4 value) {
-    glUniform4fv(get_uniform_index(shader, name), 1, (f32*)&value);
+void set_uniform_v3_f32(Gl_Shader * shader, const char * name, v3 value) {
+    auto index = get_uniform_index_for_write(shader, name, value);
+    if(index != -1) {
+        glUniform3fv(index, 1, (f32*)&value);
+    }
 }
 
 intern force_inline
 void set_uniform_m3_f64(Gl_Shader * shader, const char * name, m3_f64 value) {
     m3 converted = m3_f64_to_m3_f32(&value);
+    shader->untracked_uniform_version++;
     glUniformMatrix3fv(get_uniform_index(shader, name), 1, GL_FALSE, (f32*)&converted);
 }
 
 intern force_inline
 void set_uniform_m4(Gl_Shader * shader, const char * name, m4 value) {
+    shader->untracked_uniform_version++;
     glUniformMatrix4fv(get_uniform_index(shader, name), 1, GL_FALSE, (f32*)&value);
 }
 
 
 intern
 void fetch_shader_uniform_values(Gl_Shader * shader) {
+    TRACE_ZONE("fetch_shader_uniform_values");
+
     For(shader->uniforms) {
 #define UNSUPPORTED(M__WHAT) printf("unsupported" M__WHAT "\n")
 
         switch(it->type)
         {
-            case GL_FLOAT: glGetUniformfv(shader->id, it->id, (f32*)&it->as); break;
-            case GL_FLOAT_VEC2: glGetUniformfv(shader->id, it->id, (f32*)&it->as); break;
-            case GL_FLOAT_VEC3: glGetUniformfv(shader->id, it->id, (f32*)&it->as); break;
-            case GL_FLOAT_VEC4: glGetUniformfv(shader->id, it->id, (f32*)&it->as); break;
-            case GL_INT:    glGetUniformiv(shader->id, it->id, (s32*)&it->as); break;
+            case GL_FLOAT: glGetUniformfv(shader->id, it->location, (f32*)&it->as); break;
+            case GL_FLOAT_VEC2: glGetUniformfv(shader->id, it->location, (f32*)&it->as); break;
+            case GL_FLOAT_VEC3: glGetUniformfv(shader->id, it->location, (f32*)&it->as); break;
+            case GL_FLOAT_VEC4: glGetUniformfv(shader->id, it->location, (f32*)&it->as); break;
+            case GL_INT:    glGetUniformiv(shader->id, it->location, (s32*)&it->as); break;
             case GL_INT_VEC2: 	UNSUPPORTED("ivec2"); break;
             case GL_INT_VEC3: 	UNSUPPORTED("ivec3"); break;
             case GL_INT_VEC4: 	UNSUPPORTED("ivec4"); break;
@@ -276,7 +884,7 @@ void fetch_shader_uniform_values(Gl_Shader * shader) {
             case GL_UNSIGNED_INT_VEC2: 	UNSUPPORTED("uvec2"); break;
             case GL_UNSIGNED_INT_VEC3: 	UNSUPPORTED("uvec3"); break;
             case GL_UNSIGNED_INT_VEC4: 	UNSUPPORTED("uvec4"); break;
-            case GL_BOOL: glGetUniformiv(shader->id, it->id, (s32*)&it->as); break;
+            case GL_BOOL: glGetUniformiv(shader->id, it->location, (s32*)&it->as); break;
             case GL_BOOL_VEC2: 	UNSUPPORTED("bvec2"); break;
             case GL_BOOL_VEC3: 	UNSUPPORTED("bvec3"); break;
             case GL_BOOL_VEC4: 	UNSUPPORTED("bvec4"); break;
@@ -290,7 +898,7 @@ void fetch_shader_uniform_values(Gl_Shader * shader) {
             case GL_FLOAT_MAT4x2: 	UNSUPPORTED("mat4x2"); break;
             case GL_FLOAT_MAT4x3: 	UNSUPPORTED("mat4x3"); break;
             case GL_SAMPLER_1D: 	UNSUPPORTED("sampler1D"); break;
-            case GL_SAMPLER_2D: 	UNSUPPORTED("sampler2D"); break;
+            case GL_SAMPLER_2D: glGetUniformiv(shader->id, it->location, (s32*)&it->as); break;
             case GL_SAMPLER_3D: 	UNSUPPORTED("sampler3D"); break;
             case GL_SAMPLER_CUBE: 	UNSUPPORTED("samplerCube"); break;
             case GL_SAMPLER_1D_SHADOW: 	UNSUPPORTED("sampler1DShadow"); break;
@@ -333,16 +941,34 @@ void fetch_shader_uniform_values(Gl_Shader * shader) {
 
 intern
 void flush_shader_uniform_values(Gl_Shader * shader) {
+    TRACE_ZONE("flush_shader_uniform_values");
+
+    s32 previous_program = -1;
+
     For(shader->uniforms) {
+        if(!it->is_dirty) {
+            continue;
+        }
+
+        it->is_dirty = false;
+
+        if(previous_program == -1) {
+            previous_program = gl_state.program;
+            if(previous_program == -1) {
+                glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+            }
+            gl_state_use_program(shader->id);
+        }
+
 #define UNSUPPORTED(M__WHAT) printf("unsupported" M__WHAT "\n")
 
         switch(it->type)
         {
-            case GL_FLOAT: set_uniform_f32(shader, it->name.str, it->as.float32); break;
-            case GL_FLOAT_VEC2: set_uniform_v2_f32(shader, it->name.str, it->as.vector2_f32); break;
-            case GL_FLOAT_VEC3: set_uniform_v3_f32(shader, it->name.str, it->as.vector3_f32); break;
-            case GL_FLOAT_VEC4: set_uniform_v4_f32(shader, it->name.str, it->as.vector4_f32); break;
-            case GL_INT:    set_uniform_s32(shader, it->name.str, it->as.signed32); break;
+            case GL_FLOAT: glUniform1f(it->location, it->as.float32); break;
+            case GL_FLOAT_VEC2: glUniform2fv(it->location, 1, (f32*)&it->as.vector2_f32); break;
+            case GL_FLOAT_VEC3: glUniform3fv(it->location, 1, (f32*)&it->as.vector3_f32); break;
+            case GL_FLOAT_VEC4: glUniform4fv(it->location, 1, (f32*)&it->as.vector4_f32); break;
+            case GL_INT:    glUniform1i(it->location, it->as.signed32); break;
             case GL_INT_VEC2: 	UNSUPPORTED("ivec2"); break;
             case GL_INT_VEC3: 	UNSUPPORTED("ivec3"); break;
             case GL_INT_VEC4: 	UNSUPPORTED("ivec4"); break;
@@ -350,7 +976,7 @@ void flush_shader_uniform_values(Gl_Shader * shader) {
             case GL_UNSIGNED_INT_VEC2: 	UNSUPPORTED("uvec2"); break;
             case GL_UNSIGNED_INT_VEC3: 	UNSUPPORTED("uvec3"); break;
             case GL_UNSIGNED_INT_VEC4: 	UNSUPPORTED("uvec4"); break;
-            case GL_BOOL: set_uniform_s32(shader, it->name.str, it->as.boolean); break;
+            case GL_BOOL: glUniform1i(it->location, it->as.boolean); break;
             case GL_BOOL_VEC2: 	UNSUPPORTED("bvec2"); break;
             case GL_BOOL_VEC3: 	UNSUPPORTED("bvec3"); break;
             case GL_BOOL_VEC4: 	UNSUPPORTED("bvec4"); break;
@@ -364,7 +990,7 @@ void flush_shader_uniform_values(Gl_Shader * shader) {
             case GL_FLOAT_MAT4x2: 	UNSUPPORTED("mat4x2"); break;
             case GL_FLOAT_MAT4x3: 	UNSUPPORTED("mat4x3"); break;
             case GL_SAMPLER_1D: 	UNSUPPORTED("sampler1D"); break;
-            case GL_SAMPLER_2D: 	UNSUPPORTED("sampler2D"); break;
+            case GL_SAMPLER_2D: glUniform1i(it->location, it->as.signed32); break;
             case GL_SAMPLER_3D: 	UNSUPPORTED("sampler3D"); break;
             case GL_SAMPLER_CUBE: 	UNSUPPORTED("samplerCube"); break;
             case GL_SAMPLER_1D_SHADOW: 	UNSUPPORTED("sampler1DShadow"); break;
@@ -404,16 +1030,290 @@ void flush_shader_uniform_values(Gl_Shader * shader) {
 #undef UNSUPPORTED
     }
 
+    if(previous_program != -1) {
+        gl_state_use_program(previous_program);
+    }
 }
 
+// NOTE(justas): inotify watches on the directories our assets live in. Editors tend to
+// save by writing a temp file and renaming it over the old one, so a watch on the file
+// itself would lose track of it after the first save.
+//
+// The watcher thread waits until a file has been quiet for FILE_WATCHER_SETTLE_SECONDS
+// so a burst of writes from one save turns into a single change.
+//
+// Watched assets don't poll their mtime, so a change we can't hand over can't just be
+// dropped. When the queue is full or inotify overflows we ask the main loop to rescan,
+// which has every watched asset compare its contents again.
+#define FILE_WATCHER_SETTLE_SECONDS 0.05
+#define MAX_PENDING_FILE_CHANGES 64
+#define FILE_WATCHER_EVENT_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ATTRIB)
+
+struct File_Change {
+    s32 watch;
+    u64 name_hash;
+};
+
+struct Pending_File_Change {
+    File_Change change;
+    timespec last_event_time;
+};
+
+struct File_Watcher {
+    b32 is_running;
+    s32 inotify_fd;
+    s32 wake_fds[2];
+    s32 should_stop;
+    Plat_Thread thread;
+
+    Spsc_Queue<File_Change> changes;
+    s32 needs_rescan;
+
+    // NOTE(justas): only touched by the watcher thread
+    Pending_File_Change pending[MAX_PENDING_FILE_CHANGES];
+    s64 num_pending;
+};
+
+intern File_Watcher file_watcher = {};
+
 intern
-b32 does_asset_need_loading(Asset_Entry * asset) {
-    auto ret = false;
-    if(asset->needs_first_load) {
+void file_watcher_add_pending(File_Watcher * watcher, File_Change change, timespec now) {
+    ForRange(index, 0, watcher->num_pending) {
+        auto * it = watcher->pending + index;
+        if(it->change.watch == change.watch && it->change.name_hash == change.name_hash) {
+            it->last_event_time = now;
+            return;
+        }
+    }
+
+    if(watcher->num_pending >= MAX_PENDING_FILE_CHANGES) {
+        // NOTE(justas): too much going on to coalesce, hand it over as is.
+        if(!spsc_queue_push(&watcher->changes, change)) {
+            atomic_store(&watcher->needs_rescan, 1);
+        }
+        return;
+    }
+
+    auto * pending = watcher->pending + watcher->num_pending++;
+    pending->change = change;
+    pending->last_event_time = now;
+}
+
+intern
+void file_watcher_proc(void * data) {
+    auto * watcher = (File_Watcher*)data;
+
+    alignas(inotify_event) u8 buffer[4096];
+
+    while(!atomic_fetch(&watcher->should_stop)) {
+        auto now = plat_get_high_frequency_time();
+        s32 timeout_ms = -1;
+
+        for(s64 index = 0; index < watcher->num_pending;) {
+            auto * it = watcher->pending + index;
+            auto quiet_for = plat_get_time_delta_in_seconds(now, it->last_event_time);
+
+            if(quiet_for >= FILE_WATCHER_SETTLE_SECONDS) {
+                if(spsc_queue_push(&watcher->changes, it->change)) {
+                    *it = watcher->pending[--watcher->num_pending];
+                    continue;
+                }
+
+                // NOTE(justas): render loop hasn't caught up, try again in a bit.
+                timeout_ms = 1;
+            }
+            else {
+                auto remaining_ms = (s32)((FILE_WATCHER_SETTLE_SECONDS - quiet_for) * 1000.0) + 1;
+                if(timeout_ms == -1 || remaining_ms < timeout_ms) {
+                    timeout_ms = remaining_ms;
+                }
+            }
+
+            index++;
+        }
+
+        pollfd fds[2] = {};
+        fds[0].fd = watcher->inotify_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = watcher->wake_fds[0];
+        fds[1].events = POLLIN;
+
+        auto result = poll(fds, ARRAY_SIZE(fds), timeout_ms);
+        if(result < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            printf("file watcher: poll failed, errno %d\n", errno);
+            break;
+        }
+
+        if(fds[1].revents) {
+            break;
+        }
+
+        if(!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        auto num_read = read(watcher->inotify_fd, buffer, sizeof(buffer));
+        if(num_read <= 0) {
+            continue;
+        }
+
+        now = plat_get_high_frequency_time();
+
+        for(s64 offset = 0; offset < num_read;) {
+            auto * event = (inotify_event*)(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if(event->mask & IN_Q_OVERFLOW) {
+                atomic_store(&watcher->needs_rescan, 1);
+                continue;
+            }
+
+            if(event->len == 0) {
+                continue;
+            }
+
+            File_Change change;
+            change.watch = event->wd;
+            change.name_hash = hash_fnv(make_string(event->name));
+            file_watcher_add_pending(watcher, change, now);
+        }
+    }
+}
+
+intern
+b32 try_start_file_watcher(File_Watcher * watcher) {
+    *watcher = {};
+
+    watcher->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watcher->inotify_fd == -1) {
+        printf("file watcher: inotify_init1 failed, errno %d\n", errno);
+        return false;
+    }
+
+    if(pipe(watcher->wake_fds) != 0) {
+        printf("file watcher: pipe failed, errno %d\n", errno);
+        close(watcher->inotify_fd);
+        return false;
+    }
+
+    watcher->changes = make_spsc_queue<File_Change>(256, &malloc_allocator);
+
+    if(!plat_thread_start(&watcher->thread, file_watcher_proc, watcher)) {
+        printf("file watcher: failed to start the watcher thread\n");
+        spsc_queue_free(&watcher->changes);
+        close(watcher->wake_fds[0]);
+        close(watcher->wake_fds[1]);
+        close(watcher->inotify_fd);
+        return false;
+    }
+
+    watcher->is_running = true;
+    return true;
+}
+
+intern
+void stop_file_watcher(File_Watcher * watcher) {
+    if(!watcher->is_running) {
+        return;
+    }
+
+    atomic_store(&watcher->should_stop, 1);
+
+    auto did_wake = write(watcher->wake_fds[1], "x", 1) == 1;
+    if(!did_wake) {
+        // NOTE(justas): closing the write end hangs up the pipe, which wakes the poll just the same.
+        printf("file watcher: failed to wake the watcher thread, errno %d\n", errno);
+        close(watcher->wake_fds[1]);
+    }
+
+    plat_thread_join(&watcher->thread);
+
+    spsc_queue_free(&watcher->changes);
+    close(watcher->wake_fds[0]);
+    if(did_wake) {
+        close(watcher->wake_fds[1]);
+    }
+    close(watcher->inotify_fd);
+
+    watcher->is_running = false;
+}
+
+intern
+void file_watcher_watch(File_Watcher * watcher, Asset_Entry * asset) {
+    if(!watcher->is_running) {
+        return;
+    }
+
+    auto path = make_string(asset->path);
+    auto separator_index = string_last_index_of(path, "/"_S);
+
+    auto dir = "."_S;
+    auto name = path;
+
+    if(separator_index != -1) {
+        dir = make_string(path.str, separator_index);
+        name = make_string(path.str + separator_index + 1, path.length - separator_index - 1);
+    }
+
+    Memory_Allocation cdir_mem;
+    auto cdir = copy_and_null_terminate_string(dir, &main_thread_allocator, "file watcher dir", &cdir_mem);
+    defer { memory_allocator_free(&main_thread_allocator, cdir_mem); };
+
+    // NOTE(justas): adding a watch for a directory we already watch gives back the same descriptor.
+    auto watch = inotify_add_watch(watcher->inotify_fd, cdir, FILE_WATCHER_EVENT_MASK);
+    if(watch == -1) {
+        printf("file watcher: failed to watch '%.*s', falling back to polling it\n", (s32)dir.length, dir.str);
+        return;
+    }
+
+    asset->watch = watch;
+    asset->watch_name_hash = hash_fnv(name);
+}
+
+intern force_inline
+void mark_asset_if_changed(Asset_Entry * asset, File_Change change) {
+    if(asset->watch == change.watch && asset->watch_name_hash == change.name_hash) {
+        asset->has_changed = true;
+    }
+}
+
+intern force_inline
+void mark_asset_for_rescan(Asset_Entry * asset) {
+    if(asset->watch != -1) {
+        asset->has_changed = true;
+    }
+}
+
+// NOTE(justas): set for headless runs. Assets load once and are never checked for changes
+// again, so nothing stats every asset every frame.
+intern b32 are_assets_frozen = false;
+
+intern
+b32 does_asset_need_loading(Asset_Entry * asset) {
+    if(are_assets_frozen) {
+        auto ret = asset->needs_first_load;
+        asset->needs_first_load = false;
+        return ret;
+    }
+
+    auto ret = false;
+    if(asset->needs_first_load) {
         asset->last_load_time = plat_get_file_modification_time(asset->path);
         asset->needs_first_load = false;
+        file_watcher_watch(&file_watcher, asset);
         ret = true;
     }
+    else if(asset->watch != -1) {
+        // NOTE(justas): the watcher already waited for the save to settle.
+        if(asset->has_changed) {
+            asset->has_changed = false;
+            ret = true;
+        }
+    }
     else if(asset->countdown_to_load > 0) {
         asset->countdown_to_load -= dt;
         if(asset->countdown_to_load <= 0) {
@@ -433,6 +1333,19 @@ b32 does_asset_need_loading(Asset_Entry * asset) {
     return ret;
 }
 
+intern
+b32 did_asset_content_change(Asset_Entry * asset, String content) {
+    auto content_hash = hash_xx64(content);
+
+    if(asset->has_content_hash && asset->content_hash == content_hash) {
+        return false;
+    }
+
+    asset->has_content_hash = true;
+    asset->content_hash = content_hash;
+    return true;
+}
+
 intern force_inline
 Gl_Shader_Part make_gl_shader(String name) {
     Gl_Shader_Part ret = {};
@@ -472,373 +1385,3305 @@ b32 did_shader_compile_properly(
 intern u32 quad_vao;
 intern u32 quad_vbo;
 
-intern auto temp_allocator = make_arena_memory_allocator(m_new(&malloc_allocator, MEGABYTES(16)));
+// NOTE(justas): this is what gl_default_fb binds. It's 0 when we have a window and the
+// offscreen fbo when running headless.
+intern u32 default_framebuffer = 0;
+
+intern auto temp_allocator = make_chained_arena_memory_allocator(MEGABYTES(16));
 intern f32 shader_time =0;
 intern v2 mouse_pos = {};
 intern b32 is_lmb_down = false;
 intern b32 is_rmb_down = false;
 intern v2 window_size;
 
+// NOTE(justas): what the scripts draw at. Same as window_size unless dynamic resolution
+// is rendering the frame at a lower scale.
+intern v2 render_size;
+
 intern
 void process_button_state(s32 button, b32 state) {
     if(button == SDL_BUTTON_LEFT) is_lmb_down = state;
     else if(button == SDL_BUTTON_RIGHT) is_rmb_down = state;
 }
 
-intern 
-b32 try_load_renderer(
-        const char * script_dir,
-        Lua_Renderer * out_renderer,
-        String * out_error
-        
-) {
-    auto script_read = plat_fs_read_entire_file(script_dir, &temp_allocator);
-    if(!script_read.did_succeed) {
-        *out_error = "failed to read lua script\n"_S;
-        return false;
+intern
+v4 get_shader_mouse() {
+    // NOTE(justas): xy keep the last position the lmb was held down at.
+    static v4 mouse = {};
+    mouse.z = (f32)is_lmb_down;
+    mouse.w = (f32)is_rmb_down;
+
+    if(is_lmb_down) {
+        mouse.x = mouse_pos.x * (render_size.x / window_size.x);
+        mouse.y = mouse_pos.y * (render_size.y / window_size.y);
     }
 
-    auto cstring_script = temp_cstring(script_read.as_string, &temp_allocator);
+    return mouse;
+}
 
-    sol::state temp_lua;
+// NOTE(justas): opt-in for shaders. Declaring
+//     layout(std140) uniform Frame_Uniforms { float iTime; vec2 iResolution; vec4 iMouse; };
+// instead of the three plain uniforms makes the program read them from a buffer
+// that gets uploaded once per frame, no matter how many programs use it.
+#define FRAME_UNIFORM_BLOCK_NAME "Frame_Uniforms"
+#define FRAME_UNIFORM_BLOCK_BINDING 0
+
+struct Frame_Uniform_Block {
+    f32 time;
+    f32 pad0; // NOTE(justas): std140 aligns vec2 to 8 bytes
+    v2 resolution;
+    v4 mouse;
+};
 
-    auto script_result = temp_lua.script(cstring_script, [](lua_State*, sol::protected_function_result pfr) {
-        return pfr;
+static_assert(sizeof(Frame_Uniform_Block) == 32, "Frame_Uniform_Block must match the std140 layout");
 
-    }, "render script");
+intern u32 frame_uniform_buffer;
 
-    if(!script_result.valid()) {
-        sol::error e = script_result;
-        *out_error = make_string(e.what());
-        return false;
-    }
+intern
+void update_frame_uniform_buffer() {
+    Frame_Uniform_Block block = {};
+    block.time = shader_time;
+    block.resolution = render_size;
+    block.mouse = get_shader_mouse();
+
+    glBindBuffer(GL_UNIFORM_BUFFER, frame_uniform_buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
 
-    *out_renderer = {};
-    auto & our_rend = *out_renderer;
-    our_rend.temp_alloc = &temp_allocator;
-    our_rend.alloc = make_tracked_memory_allocator(&base_untracked_malloc_allocator);
-    our_rend.asset_catalogue = make_table<Asset_Entry>(8, &our_rend.alloc, "asset catalogue"_S);
-    our_rend.shader_parts = make_table<Gl_Shader_Part>(8, &our_rend.alloc, "shader parts"_S);
-    our_rend.shaders = make_table<Gl_Shader>(8, &our_rend.alloc, "shaders"_S);
-    our_rend.lua = std::move(temp_lua);
-    our_rend.needs_free = true;
-    our_rend.can_render = true;
+// NOTE(justas): per frame breakdown of where the time goes. CPU zones are clock readings,
+// GPU zones are a pair of GL_TIMESTAMP queries around the GL calls a script makes. Those
+// can nest and don't get in the way of the GL_TIME_ELAPSED query dynamic resolution keeps
+// open over the whole frame. Frames are double buffered, a frame's queries get read when
+// its slot comes around again and are dropped if the gpu still isn't done with them.
+#define MAX_PROFILER_ZONES 256
+#define NUM_PROFILER_FRAMES 2
+#define PROFILER_ZONE_NAME_LENGTH 48
+
+// NOTE(justas): reading GL_TIMESTAMP waits for the gpu, so the clocks only get lined up again
+// this often to follow drift.
+#define PROFILER_CLOCK_SYNC_INTERVAL 600
+
+enum PROFILER_ZONE_ {
+    PROFILER_ZONE_CPU,
+    PROFILER_ZONE_GPU,
+};
 
-    auto & lua = our_rend.lua;
+struct Profiler_Zone {
+    char name[PROFILER_ZONE_NAME_LENGTH];
+    PROFILER_ZONE_ kind;
+    s32 depth;
 
-    lua.open_libraries(sol::lib::base);
-    lua["GL_VERTEX"] = GL_VERTEX_SHADER;
-    lua["GL_FRAGMENT"] = GL_FRAGMENT_SHADER;
+    // NOTE(justas): seconds since the profiler started, gpu ones get moved onto the cpu clock.
+    f64 start;
+    f64 end;
+};
 
-    lua["gl_set_default_uniforms"] = [](Lua_Renderer * r) {
-        set_uniform_f32(&r->active_shader, "iTime", shader_time);
-        set_uniform_v2_f32(&r->active_shader, "iResolution", window_size);
+struct Profiler_Frame {
+    s64 frame_index;
+    Profiler_Zone zones[MAX_PROFILER_ZONES];
+    s64 num_zones;
 
-        static v4 mouse = {};
-        mouse.z = (f32)is_lmb_down;
-        mouse.w = (f32)is_rmb_down;
+    u32 queries[MAX_PROFILER_ZONES * 2];
+    s64 last_query_zone;
 
-        if(is_lmb_down) {
-            mouse.x = mouse_pos.x;
-            mouse.y = mouse_pos.y;
-        }
+    // NOTE(justas): cpu seconds - gpu seconds, the profiler's offset when the frame started.
+    f64 gpu_to_cpu;
+};
 
-        set_uniform_v4_f32(&r->active_shader, "iMouse", mouse);
-    };
+struct Trace_Event {
+    char name[PROFILER_ZONE_NAME_LENGTH];
+    PROFILER_ZONE_ kind;
+    f64 start;
+    f64 end;
+};
 
-    lua["gl_load_shader_part"] = [](Lua_Renderer * r, const char * cname, s32 type, const char * dir) {
-        auto name = make_string(cname);
-        auto hash = hash_fnv(name);
+struct Profiler {
+    b32 is_enabled;
+    timespec start_time;
 
-        auto * asset = r->get_asset(hash, dir);
-        auto * part = table_insert_or_initialize_new(&r->shader_parts, hash);
-        part->name = name;
+    Profiler_Frame frames[NUM_PROFILER_FRAMES];
+    s64 current_frame;
+    s32 cpu_depth;
 
-        auto load = false;
+    f64 gpu_to_cpu;
+    s64 frames_until_clock_sync;
 
-        if(does_asset_need_loading(asset)) {
-            load = true;
-        }
+    // NOTE(justas): the newest frame with all of its gpu results in, what the panel shows.
+    Profiler_Frame shown;
+    s64 num_dropped_frames;
 
-        if(load) {
-            if(part->id != -1) {
-                glDeleteProgram(part->id);
-                part->id = -1;
-            }
+    b32 is_tracing;
 
-            part->comparison_hash = hash * 13 + asset->last_load_time;
+    // NOTE(justas): a long trace grows these a lot. Each one sits alone on a reserved
+    // arena so it grows in place instead of getting copied every time it doubles.
+    Memory_Allocator trace_event_memory;
+    Array<Trace_Event> trace_events;
 
-            string_free(&malloc_allocator, &part->error);
+#if defined(STORMY_TRACE)
+    // NOTE(justas): TRACE_ZONEs from every thread, drained once a frame.
+    Memory_Allocator trace_record_memory;
+    Array<Trace_Record> trace_records;
+#endif
+};
 
-            auto read = plat_fs_read_entire_file(dir, r->temp_alloc);
+intern Profiler profiler = {};
 
-            if(!read.did_succeed) {
-                part->error = "failed to read shader"_S;
-                printf("failed to read shader %s\n", dir);
-                return (void*)hash;
-            }
+intern force_inline
+f64 profiler_now(Profiler * p) {
+    return plat_get_time_delta_in_seconds(plat_get_high_frequency_time(), p->start_time);
+}
 
-            String error;
-            u32 part_id;
-            auto result = compile_shader_part(type, read.as_string, empty_string, r->temp_alloc, &error, &part_id);
-            if(!result) {
-                printf("failed to compile shader '%s': %.*s\n", cname, error.length, error.str);
+intern
+void profiler_sync_clocks(Profiler * p) {
+    s64 gpu_ns = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_ns);
+    p->gpu_to_cpu = profiler_now(p) - (f64)gpu_ns / 1000000000.0;
+    p->frames_until_clock_sync = PROFILER_CLOCK_SYNC_INTERVAL;
+}
 
-                auto a = make_string_copy(error, &malloc_allocator);
-                part->error = a.string;
+intern
+void profiler_start(Profiler * p) {
+    if(p->is_enabled) {
+        return;
+    }
 
-                return (void*)hash;
-            }
+    *p = {};
+    p->is_enabled = true;
+    p->start_time = plat_get_high_frequency_time();
+    p->current_frame = -1;
+    p->shown.frame_index = -1;
+    p->trace_event_memory = make_virtual_arena_memory_allocator(GIGABYTES((s64)16), true);
+    p->trace_events = make_array<Trace_Event>(1024, &p->trace_event_memory, "trace events"_S);
+
+#if defined(STORMY_TRACE)
+    p->trace_record_memory = make_virtual_arena_memory_allocator(GIGABYTES((s64)16), true);
+    p->trace_records = make_array<Trace_Record>(4096, &p->trace_record_memory, "trace records"_S);
+#endif
+
+    ForRange(index, 0, NUM_PROFILER_FRAMES) {
+        p->frames[index].frame_index = -1;
+        glGenQueries(MAX_PROFILER_ZONES * 2, p->frames[index].queries);
+    }
 
-            printf("compiled new shader '%s' %d %d %llu\n", cname, type, part_id, hash);
+    profiler_sync_clocks(p);
+}
 
-            part->id = part_id;
-        }
+intern
+void profiler_stop(Profiler * p) {
+    if(!p->is_enabled) {
+        return;
+    }
 
-        return (void*)hash;
-    };
+    ForRange(index, 0, NUM_PROFILER_FRAMES) {
+        glDeleteQueries(MAX_PROFILER_ZONES * 2, p->frames[index].queries);
+    }
 
-    lua["find_file_that_starts_with_in_folder"] = [](Lua_Renderer * r, const char * cstarts_with, const char * in_folder) {
-        auto * temp = r->temp_alloc;
-        auto files = get_all_files_in_directory(in_folder, temp);
+    free_virtual_arena_memory_allocator(&p->trace_event_memory);
 
-        auto starts_with = make_string(cstarts_with);
+#if defined(STORMY_TRACE)
+    trace_stop();
+    free_virtual_arena_memory_allocator(&p->trace_record_memory);
+#endif
 
-        For(files) {
-            if(!it->is_file) {
+    *p = {};
+}
+
+intern
+void profiler_collect_frame(Profiler * p, Profiler_Frame * frame) {
+    if(frame->frame_index == -1) {
+        return;
+    }
+
+    if(frame->last_query_zone != -1) {
+        // NOTE(justas): queries finish in order, if the last one is in so are the rest.
+        s32 is_available = GL_FALSE;
+        glGetQueryObjectiv(frame->queries[frame->last_query_zone * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &is_available);
+
+        if(!is_available) {
+            p->num_dropped_frames++;
+            return;
+        }
+
+        ForRange(index, 0, frame->num_zones) {
+            auto * zone = frame->zones + index;
+            if(zone->kind != PROFILER_ZONE_GPU) {
                 continue;
             }
-            if(string_starts_with(it->name, starts_with)) {
-                return temp_cstring(it->name, temp);
-            }
-        }
 
-        return "file_not_found";
-    };
+            u64 start_ns = 0;
+            u64 end_ns = 0;
+            glGetQueryObjectui64v(frame->queries[index * 2], GL_QUERY_RESULT, &start_ns);
+            glGetQueryObjectui64v(frame->queries[index * 2 + 1], GL_QUERY_RESULT, &end_ns);
 
-    lua["gl_use_shader"] = [](Lua_Renderer * r, void * void_shader_hash) {
-        auto shader_hash = (u64)void_shader_hash;
-        auto * shader = table_insert_or_initialize_new(&r->shaders, shader_hash);
+            zone->start = (f64)start_ns / 1000000000.0 + frame->gpu_to_cpu;
+            zone->end = (f64)end_ns / 1000000000.0 + frame->gpu_to_cpu;
+        }
+    }
 
-        if(shader->id == -1) {
-            return;
+    if(p->is_tracing) {
+        ForRange(index, 0, frame->num_zones) {
+            auto * zone = frame->zones + index;
+            auto * event = array_append(&p->trace_events);
+            copy_bytes((u8*)event->name, (u8*)zone->name, PROFILER_ZONE_NAME_LENGTH);
+            event->kind = zone->kind;
+            event->start = zone->start;
+            event->end = zone->end;
         }
+    }
 
-        glUseProgram(shader->id);
-        r->active_shader = *shader;
-    };
+    p->shown.frame_index = frame->frame_index;
+    p->shown.num_zones = frame->num_zones;
+    copy_bytes((u8*)p->shown.zones, (u8*)frame->zones, frame->num_zones * sizeof(Profiler_Zone));
 
-    lua["target_fps"] = [](Lua_Renderer * r, f32 target_fps) {
-        r->target_fps = target_fps;
-    };
+    frame->frame_index = -1;
+}
 
-    lua["gl_load_shader"] = [](Lua_Renderer * r, const char * cname, sol::table t) {
+// NOTE(justas): waits on the gpu, only for when a trace is about to be written.
+intern
+void profiler_flush(Profiler * p) {
+    if(!p->is_enabled || p->current_frame == -1) {
+        return;
+    }
 
-        auto name = make_string(cname);
-        auto hash = hash_fnv(name);
+    glFinish();
 
-        auto * shader = table_insert_or_initialize_new(&r->shaders, hash);
-        shader->name = name;
+    ForRange(offset, 1, NUM_PROFILER_FRAMES + 1) {
+        profiler_collect_frame(p, p->frames + (p->current_frame + offset) % NUM_PROFILER_FRAMES);
+    }
 
-        auto needs_reload = false;
+#if defined(STORMY_TRACE)
+    if(p->is_tracing) {
+        trace_drain(&p->trace_records);
+    }
+#endif
+}
 
-        auto has_hash_mismatch = false;
-        auto num_parts = 0;
-        for(auto & kvp : t) {
-            num_parts++;
+intern
+void profiler_start_tracing(Profiler * p) {
+    profiler_start(p);
+    array_clear(&p->trace_events);
+    p->is_tracing = true;
+
+#if defined(STORMY_TRACE)
+    array_clear(&p->trace_records);
+    trace_start();
+#endif
+}
 
-            auto part_hash = (u64)kvp.second.as<void*>();
-            auto * part = table_insert_or_initialize_new(&r->shader_parts, part_hash);
+intern
+void profiler_stop_tracing(Profiler * p) {
+    p->is_tracing = false;
+
+    // NOTE(justas): gives the pages of a long trace back to the os.
+    memory_allocator_arena_reset(&p->trace_event_memory);
+    p->trace_events = make_array<Trace_Event>(1024, &p->trace_event_memory, "trace events"_S);
+
+#if defined(STORMY_TRACE)
+    trace_stop();
+    memory_allocator_arena_reset(&p->trace_record_memory);
+    p->trace_records = make_array<Trace_Record>(4096, &p->trace_record_memory, "trace records"_S);
+#endif
+}
 
-            auto does_have_this_hash = false;
-            for(auto * it : shader->part_hashes) {
-                if(*it == part->comparison_hash) {
-                    does_have_this_hash = true;
-                    break;
-                }
-            }
+intern
+void profiler_begin_frame(Profiler * p, s64 frame_index) {
+    if(!p->is_enabled) {
+        return;
+    }
 
-            if(!does_have_this_hash) {
-                has_hash_mismatch = true;
-                break;
-            }
-        }
+    p->current_frame = (p->current_frame + 1) % NUM_PROFILER_FRAMES;
+    auto * frame = p->frames + p->current_frame;
 
-        if(has_hash_mismatch) {
-            needs_reload = true;
-        }
-        else if(shader->part_hashes.watermark <= 0 && num_parts > 0) {
-            needs_reload = true;
-        }
+    profiler_collect_frame(p, frame);
 
-        if(needs_reload) {
-            array_clear(&shader->part_hashes);
-            string_free(&malloc_allocator, &shader->error);
+#if defined(STORMY_TRACE)
+    if(p->is_tracing) {
+        trace_drain(&p->trace_records);
+    }
+#endif
 
-            shader->clear_uniforms();
-    
-            auto id = glCreateProgram();
+    frame->frame_index = frame_index;
+    frame->num_zones = 0;
+    frame->last_query_zone = -1;
+    p->cpu_depth = 0;
 
-            printf("reloading shader %s\n", cname);
+    p->frames_until_clock_sync--;
+    if(p->frames_until_clock_sync <= 0) {
+        profiler_sync_clocks(p);
+    }
+    frame->gpu_to_cpu = p->gpu_to_cpu;
+}
+
+intern
+s64 profiler_begin_zone(Profiler * p, PROFILER_ZONE_ kind, String name) {
+    if(!p->is_enabled || p->current_frame == -1) {
+        return -1;
+    }
+
+    auto * frame = p->frames + p->current_frame;
+    if(frame->num_zones >= MAX_PROFILER_ZONES) {
+        return -1;
+    }
+
+    auto index = frame->num_zones++;
+    auto * zone = frame->zones + index;
+
+    auto length = MIN(name.length, (s64)PROFILER_ZONE_NAME_LENGTH - 1);
+    copy_bytes((u8*)zone->name, (u8*)name.str, length);
+    zone->name[length] = '\0';
+
+    zone->kind = kind;
+
+    if(kind == PROFILER_ZONE_CPU) {
+        zone->depth = p->cpu_depth++;
+        zone->start = profiler_now(p);
+    }
+    else {
+        zone->depth = 0;
+        glQueryCounter(frame->queries[index * 2], GL_TIMESTAMP);
+    }
+
+    zone->end = zone->start;
+    return index;
+}
+
+intern
+void profiler_end_zone(Profiler * p, s64 index) {
+    if(index == -1) {
+        return;
+    }
+
+    auto * frame = p->frames + p->current_frame;
+    auto * zone = frame->zones + index;
+
+    if(zone->kind == PROFILER_ZONE_CPU) {
+        zone->end = profiler_now(p);
+        p->cpu_depth--;
+    }
+    else {
+        glQueryCounter(frame->queries[index * 2 + 1], GL_TIMESTAMP);
+        frame->last_query_zone = index;
+    }
+}
+
+intern force_inline
+s64 profiler_begin_cpu(String name) {
+    return profiler_begin_zone(&profiler, PROFILER_ZONE_CPU, name);
+}
+
+intern force_inline
+s64 profiler_begin_gpu(String name) {
+    return profiler_begin_zone(&profiler, PROFILER_ZONE_GPU, name);
+}
+
+intern force_inline
+void profiler_end(s64 zone) {
+    profiler_end_zone(&profiler, zone);
+}
+
+intern
+void write_json_escaped(FILE * f, const char * str) {
+    for(auto * at = str; *at; at++) {
+        if(*at == '"' || *at == '\\') {
+            fputc('\\', f);
+        }
+
+        if((u8)*at < 0x20) {
+            continue;
+        }
+
+        fputc(*at, f);
+    }
+}
+
+// NOTE(justas): chrome://tracing and Perfetto both open this. CPU zones are on thread 1,
+// GPU zones on thread 2 and TRACE_ZONEs on one thread each after that.
+intern
+b32 profiler_write_chrome_trace(Profiler * p, const char * path) {
+    auto * f = fopen(path, "wb");
+    if(!f) {
+        return false;
+    }
+
+    fputs("{\"traceEvents\":[\n", f);
+    fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cpu\"}},\n", f);
+    fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"gpu\"}}", f);
+
+#if defined(STORMY_TRACE)
+    auto trace_offset = plat_get_time_delta_in_seconds(trace_state.epoch, p->start_time);
+    auto num_trace_threads = MIN(atomic_fetch(&trace_state.num_threads), (s64)MAX_TRACE_THREADS);
+
+    ForRange(index, 0, num_trace_threads) {
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lld,\"args\":{\"name\":\"thread %lld\"}}", index + 3, index);
+    }
+
+    For(p->trace_records) {
+        fputs(",\n{\"name\":\"", f);
+        write_json_escaped(f, it->name);
+        fprintf(f, "\",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":%lld,\"ts\":%.3f,\"dur\":%.3f}",
+            it->thread + 3,
+            (it->start + trace_offset) * 1000000.0,
+            (it->end - it->start) * 1000000.0
+        );
+    }
+#endif
+
+    For(p->trace_events) {
+        fputs(",\n{\"name\":\"", f);
+        write_json_escaped(f, it->name);
+        fprintf(f, "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            it->kind == PROFILER_ZONE_CPU ? "cpu" : "gpu",
+            it->kind == PROFILER_ZONE_CPU ? 1 : 2,
+            it->start * 1000000.0,
+            (it->end - it->start) * 1000000.0
+        );
+    }
+
+    fputs("\n]}\n", f);
+    fclose(f);
+
+    return true;
+}
+
+intern
+void profiler_draw_panel(Profiler * p) {
+    auto * frame = &p->shown;
+
+    if(!ImGui::Begin("Profiler")) {
+        ImGui::End();
+        return;
+    }
+
+    if(frame->frame_index == -1) {
+        ImGui::Text("waiting for the first frame...");
+        ImGui::End();
+        return;
+    }
+
+    auto frame_start = F64_POSITIVE_MAXIMUM;
+    auto frame_end = F64_NEGATIVE_MAXIMUM;
+    f64 total_gpu = 0;
+
+    ForRange(index, 0, frame->num_zones) {
+        auto * zone = frame->zones + index;
+        frame_start = MIN(frame_start, zone->start);
+        frame_end = MAX(frame_end, zone->end);
+
+        if(zone->kind == PROFILER_ZONE_GPU) {
+            total_gpu += zone->end - zone->start;
+        }
+    }
+
+    auto frame_length = MAX(frame_end - frame_start, 0.000001);
+
+    ImGui::Text("frame %lld, %.3fms span, %.3fms gpu, %lld frames dropped", frame->frame_index, frame_length * 1000.0, total_gpu * 1000.0, p->num_dropped_frames);
+
+    auto * temp = &temp_allocator.chained;
+    ImGui::Text("temp memory: %lldKB used, %lldKB recent peak, %lldKB high water, %lldKB in %lld blocks",
+        temp->used / 1024, temp->recent_peak / 1024, temp->high_water / 1024, temp->reserved / 1024, temp->num_blocks);
+
+    if(p->is_tracing) {
+        ImGui::Text("tracing: %lld events (F3 to stop)", p->trace_events.watermark);
+
+#if defined(STORMY_TRACE)
+        ImGui::Text("trace zones: %lld, %lld dropped", p->trace_records.watermark, trace_get_num_dropped());
+#endif
+    }
+
+    // NOTE(justas): timeline, a row per cpu depth and one for the gpu at the bottom.
+    {
+        baked f32 row_height = 18;
+
+        s32 num_cpu_rows = 1;
+        ForRange(index, 0, frame->num_zones) {
+            num_cpu_rows = MAX(num_cpu_rows, frame->zones[index].depth + 1);
+        }
+
+        auto origin = ImGui::GetCursorScreenPos();
+        auto width = MAX(ImGui::GetContentRegionAvail().x, 100.f);
+        auto * draw_list = ImGui::GetWindowDrawList();
+
+        ForRange(index, 0, frame->num_zones) {
+            auto * zone = frame->zones + index;
+            auto row = zone->kind == PROFILER_ZONE_CPU ? zone->depth : num_cpu_rows;
+
+            auto x0 = origin.x + (f32)((zone->start - frame_start) / frame_length) * width;
+            auto x1 = origin.x + (f32)((zone->end - frame_start) / frame_length) * width;
+            x1 = MAX(x1, x0 + 1);
+
+            auto y0 = origin.y + row * row_height;
+            auto color = zone->kind == PROFILER_ZONE_CPU ? IM_COL32(80, 140, 220, 255) : IM_COL32(220, 120, 60, 255);
+
+            draw_list->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y0 + row_height - 2), color);
+            draw_list->PushClipRect(ImVec2(x0, y0), ImVec2(x1, y0 + row_height), true);
+            draw_list->AddText(ImVec2(x0 + 2, y0 + 1), IM_COL32(255, 255, 255, 255), zone->name);
+            draw_list->PopClipRect();
+
+            if(ImGui::IsMouseHoveringRect(ImVec2(x0, y0), ImVec2(x1, y0 + row_height))) {
+                ImGui::SetTooltip("%s: %.3fms", zone->name, (zone->end - zone->start) * 1000.0);
+            }
+        }
+
+        ImGui::Dummy(ImVec2(width, (num_cpu_rows + 1) * row_height));
+    }
+
+    if(ImGui::CollapsingHeader("zones")) {
+        ForRange(index, 0, frame->num_zones) {
+            auto * zone = frame->zones + index;
+            ImGui::Text("%s %*s%s: %.3fms",
+                zone->kind == PROFILER_ZONE_CPU ? "cpu" : "gpu",
+                zone->depth * 2, "",
+                zone->name,
+                (zone->end - zone->start) * 1000.0
+            );
+        }
+    }
+
+    ImGui::End();
+}
+
+intern b32 has_parallel_shader_compile = false;
+
+// NOTE(justas): offline renders need every frame to be drawn with the right shader,
+// so they wait for compiles like we used to.
+intern b32 should_compile_shaders_synchronously = false;
+
+intern
+void init_parallel_shader_compile(GL3WGetProcAddressProc get_proc) {
+    s32 num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+
+    const char * max_threads_proc_name = 0;
+
+    ForRange(index, 0, num_extensions) {
+        auto extension = make_string((const char*)glGetStringi(GL_EXTENSIONS, index));
+
+        if(string_equals_case_sensitive(extension, "GL_KHR_parallel_shader_compile"_S)) {
+            max_threads_proc_name = "glMaxShaderCompilerThreadsKHR";
+            break;
+        }
+
+        if(string_equals_case_sensitive(extension, "GL_ARB_parallel_shader_compile"_S)) {
+            max_threads_proc_name = "glMaxShaderCompilerThreadsARB";
+        }
+    }
+
+    if(!max_threads_proc_name) {
+        printf("no parallel shader compile support, shader reloads will block\n");
+        return;
+    }
+
+    typedef void (*Max_Shader_Compiler_Threads_Proc)(GLuint);
+    auto max_threads = (Max_Shader_Compiler_Threads_Proc)get_proc(max_threads_proc_name);
+    if(max_threads) {
+        // NOTE(justas): let the driver pick how many
+        max_threads(0xFFFFFFFF);
+    }
+
+    has_parallel_shader_compile = true;
+}
+
+intern
+b32 try_submit_shader_part(Gl_Shader_Part * part) {
+    if(part->has_compile_failed) {
+        return false;
+    }
+
+    if(part->id != -1) {
+        return true;
+    }
+
+    String error;
+    u32 part_id;
+    if(!submit_shader_part_compile(part->type, part->source, empty_string, &error, &part_id)) {
+        string_free(&main_thread_allocator, &part->error);
+        part->error = make_string_copy(error, &main_thread_allocator).string;
+        part->has_compile_failed = true;
+        return false;
+    }
+
+    part->id = part_id;
+    return true;
+}
+
+intern
+b32 check_shader_part(Gl_Shader_Part * part) {
+    if(part->is_compiled) {
+        return true;
+    }
+
+    if(part->has_compile_failed) {
+        return false;
+    }
+
+    String error;
+    if(!did_shader_part_compile_properly(part->id, &temp_allocator, &error)) {
+        printf("failed to compile shader '%.*s': %.*s\n", part->name.length, part->name.str, error.length, error.str);
+
+        string_free(&main_thread_allocator, &part->error);
+        part->error = make_string_copy(error, &main_thread_allocator).string;
+        part->has_compile_failed = true;
+        return false;
+    }
+
+    printf("compiled new shader '%.*s' %d %d\n", part->name.length, part->name.str, part->type, part->id);
+
+    part->is_compiled = true;
+    return true;
+}
+
+intern
+b32 is_shader_program_ready(u32 id) {
+    if(should_compile_shaders_synchronously || !has_parallel_shader_compile) {
+        return true;
+    }
+
+    s32 is_done = GL_FALSE;
+    glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &is_done);
+    return is_done == GL_TRUE;
+}
+
+// NOTE(justas): linked programs are kept on disk keyed by the sources of their parts
+// and the driver that linked them, so a shader we've linked before, in this run or an
+// earlier one, comes back with a single glProgramBinary instead of a compile + link.
+struct Program_Binary_Cache {
+    b32 is_enabled;
+    const char * dir;
+    u64 driver_hash;
+};
+
+struct Program_Binary_Header {
+    u32 magic;
+    u32 format;
+    s64 length;
+};
+
+baked u32 PROGRAM_BINARY_MAGIC = 0x31424c53; // NOTE(justas): "SLB1"
+
+intern Program_Binary_Cache program_binary_cache = {};
+
+intern
+void init_program_binary_cache(const char * dir) {
+    if(!dir) {
+        return;
+    }
+
+    s32 num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    if(num_formats <= 0) {
+        printf("shader cache: the driver doesn't support program binaries, disabling\n");
+        return;
+    }
+
+    if(!plat_create_directory(dir)) {
+        printf("shader cache: failed to create '%s', disabling\n", dir);
+        return;
+    }
+
+    auto hash = hash_fnv(make_string((const char*)glGetString(GL_VENDOR)));
+    hash = hash_fnv(make_string((const char*)glGetString(GL_RENDERER)), hash);
+    hash = hash_fnv(make_string((const char*)glGetString(GL_VERSION)), hash);
+
+    program_binary_cache.is_enabled = true;
+    program_binary_cache.dir = dir;
+    program_binary_cache.driver_hash = hash;
+}
+
+intern force_inline
+u64 get_program_binary_key(u64 key, Gl_Shader_Part * part) {
+    key = hash_fnv(make_string((const char*)&part->type, sizeof(part->type)), key);
+    return hash_fnv(make_string((const char*)&part->source_hash, sizeof(part->source_hash)), key);
+}
+
+// NOTE(justas): parts get compiled without defines, once they have some they go in here too.
+intern force_inline
+u64 get_shader_part_key(GLenum type, u64 source_hash) {
+    auto key = hash_fnv(make_string((const char*)&type, sizeof(type)));
+    return hash_fnv(make_string((const char*)&source_hash, sizeof(source_hash)), key);
+}
+
+intern
+void release_shader_part(Lua_Renderer * r, u64 key) {
+    auto * part = table_get(&r->shader_parts, key);
+    if(!part) {
+        return;
+    }
+
+    part->ref_count--;
+    if(part->ref_count > 0) {
+        return;
+    }
+
+    if(part->id != -1) {
+        glDeleteShader(part->id);
+    }
+
+    string_free(&main_thread_allocator, &part->source);
+    string_free(&main_thread_allocator, &part->error);
+    table_remove(&r->shader_parts, key);
+}
+
+intern force_inline
+const char * get_program_binary_path(u64 key) {
+    return format_temp_string(&temp_allocator, "%s/%016llx.bin", program_binary_cache.dir, key).str;
+}
+
+intern
+b32 try_load_program_binary(u64 key, u32 program_id) {
+    if(!program_binary_cache.is_enabled) {
+        return false;
+    }
+
+    auto read = plat_fs_read_entire_file(get_program_binary_path(key), &temp_allocator);
+    if(!read.did_succeed || read.size < (s64)sizeof(Program_Binary_Header)) {
+        return false;
+    }
+
+    auto * header = (Program_Binary_Header*)read.mem.data;
+    if(header->magic != PROGRAM_BINARY_MAGIC || header->length != read.size - (s64)sizeof(Program_Binary_Header)) {
+        return false;
+    }
+
+    glProgramBinary(program_id, header->format, header + 1, (s32)header->length);
+
+    // NOTE(justas): drivers are free to reject binaries, e.g after an update.
+    s32 status;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+intern
+void save_program_binary(u64 key, u32 program_id) {
+    if(!program_binary_cache.is_enabled) {
+        return;
+    }
+
+    s32 length = 0;
+    glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) {
+        return;
+    }
+
+    auto mem = m_new(&temp_allocator, sizeof(Program_Binary_Header) + length);
+    auto * header = (Program_Binary_Header*)mem.data;
+
+    GLenum format;
+    glGetProgramBinary(program_id, length, &length, &format, header + 1);
+
+    header->magic = PROGRAM_BINARY_MAGIC;
+    header->format = format;
+    header->length = length;
+
+    if(!plat_fs_write_entire_file(get_program_binary_path(key), mem.data, sizeof(Program_Binary_Header) + length)) {
+        printf("shader cache: failed to write program binary %016llx\n", key);
+    }
+}
+
+intern
+void install_shader_program(Lua_Renderer * r, u64 shader_hash, Gl_Shader * shader, u32 id) {
+    shader->clear_uniforms();
+
+    if(shader->id != -1) {
+        gl_state_forget_program(shader->id);
+        glDeleteProgram(shader->id);
+    }
+
+    shader->id = id;
+    shader->frame_dependencies = 0;
+
+    // NOTE(justas): keep whatever the script bound pointing at a live program
+    if(r->active_shader_hash == shader_hash) {
+        gl_state_use_program(id);
+    }
+
+    {
+        s32 num_uniforms;
+        s32 max_name_length;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &num_uniforms);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+        array_reserve(&shader->uniforms, num_uniforms);
+
+        ForRange(index, 0, num_uniforms) {
+            auto name_alloc = m_new(&main_thread_allocator, max_name_length);
+
+            s32 name_length;
+            s32 array_size;
+            GLenum type;
+            glGetActiveUniform(id, index, max_name_length, &name_length, &array_size, &type, (GLchar*)name_alloc.data);
+
+            auto name = make_string((const char*)name_alloc.data, name_length);
+            auto location = glGetUniformLocation(id, name.str);
+
+            // NOTE(justas): before the location check, Frame_Uniforms members count too.
+            if(string_equals_case_sensitive(name, "iTime"_S)) shader->frame_dependencies |= FRAME_DEPENDENCY_TIME;
+            else if(string_equals_case_sensitive(name, "iResolution"_S)) shader->frame_dependencies |= FRAME_DEPENDENCY_RESOLUTION;
+            else if(string_equals_case_sensitive(name, "iMouse"_S)) shader->frame_dependencies |= FRAME_DEPENDENCY_MOUSE;
+
+            // NOTE(justas): members of uniform blocks have no location,
+            // their values come from the block's buffer.
+            if(location == -1) {
+                m_free(&main_thread_allocator, name_alloc);
+                continue;
+            }
+
+            s64 info_index;
+            auto * uniform = array_append(&shader->uniforms, &info_index);
+            uniform->name = name;
+            uniform->type = type;
+            uniform->location = location;
+            uniform->is_dirty = false;
+
+            Uniform_Location cached;
+            cached.location = location;
+            cached.info_index = (s32)info_index;
+
+            *table_insert(&shader->uniform_locations, name) = cached;
+
+            // NOTE(justas): arrays are reported as "name[0]", but scripts
+            // address the first element by the bare name too.
+            if(string_ends_with(name, "[0]"_S)) {
+                auto bare_name = make_string(name.str, name.length - 3);
+                *table_insert(&shader->uniform_locations, bare_name) = cached;
+            }
+        }
+
+        // NOTE(justas): the only readback we do, from here on the shadow
+        // values are kept in sync by whoever writes to them.
+        fetch_shader_uniform_values(shader);
+    }
+
+    {
+        auto block_index = glGetUniformBlockIndex(id, FRAME_UNIFORM_BLOCK_NAME);
+        if(block_index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(id, block_index, FRAME_UNIFORM_BLOCK_BINDING);
+
+            // NOTE(justas): members of a block with an instance name come out prefixed,
+            // don't bother and assume it reads all of them.
+            shader->frame_dependencies |= FRAME_DEPENDENCY_TIME | FRAME_DEPENDENCY_RESOLUTION | FRAME_DEPENDENCY_MOUSE;
+        }
+    }
+}
+
+intern
+void finish_pending_shader_program(Lua_Renderer * r, u64 shader_hash, Gl_Shader * shader) {
+    auto id = shader->pending_id;
+    shader->pending_id = -1;
+
+    string_free(&main_thread_allocator, &shader->error);
+
+    // NOTE(justas): a part that failed to compile also fails the link, its
+    // log is the more useful one to show.
+    String error = empty_string;
+    For(shader->pending_parts) {
+        auto * part = table_get(&r->shader_parts, *it);
+        if(part && !check_shader_part(part)) {
+            error = part->error;
+            break;
+        }
+    }
+
+    if(error.length == 0 && !did_shader_compile_properly(id, &temp_allocator, &error)) {
+        printf("Failed to compile shader '%.*s'. Error:\n", shader->name.length, shader->name.str);
+        printf("%.*s\n", error.length, error.str);
+    }
+
+    if(error.length > 0) {
+        auto a = make_string_copy(error, &main_thread_allocator);
+        shader->error = a.string;
+
+        glDeleteProgram(id);
+        return;
+    }
+
+    save_program_binary(shader->pending_binary_key, id);
+    install_shader_program(r, shader_hash, shader, id);
+}
+
+intern force_inline
+void set_default_uniforms(Gl_Shader * shader, v2 resolution) {
+    set_uniform_f32(shader, "iTime", shader_time);
+    set_uniform_v2_f32(shader, "iResolution", resolution);
+    set_uniform_v4_f32(shader, "iMouse", get_shader_mouse());
+}
+
+intern force_inline
+void draw_quad() {
+    gl_state_bind_vertex_array(quad_vao);
+    gl_state_bind_array_buffer(quad_vbo);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+intern
+b32 try_parse_render_target_format(String name, GLenum * out_format) {
+    if(string_equals_case_sensitive(name, "rgba8"_S)) *out_format = GL_RGBA8;
+    else if(string_equals_case_sensitive(name, "srgb8"_S)) *out_format = GL_SRGB8_ALPHA8;
+    else if(string_equals_case_sensitive(name, "rgba16f"_S)) *out_format = GL_RGBA16F;
+    else if(string_equals_case_sensitive(name, "rgba32f"_S)) *out_format = GL_RGBA32F;
+    else if(string_equals_case_sensitive(name, "r16f"_S)) *out_format = GL_R16F;
+    else return false;
+
+    return true;
+}
+
+// NOTE(justas): scaled targets are allocated off the window size, not render_size, so
+// dynamic resolution moving the scale doesn't recreate them every step.
+intern
+v2_s32 get_render_target_size(Render_Target * target) {
+    v2 size = target->fixed_size;
+    if(size.x <= 0 || size.y <= 0) {
+        size = window_size * target->scale;
+    }
+
+    return make_vector_s32(MAX((s32)size.x, 1), MAX((s32)size.y, 1));
+}
+
+// NOTE(justas): the bottom left corner of the texture that passes draw into this frame. Same
+// as the texture for fixed size targets, render_size * scale for scaled ones.
+intern
+v2 get_render_target_draw_size(Render_Target * target, Render_Texture * tex) {
+    v2 size = make_vector((f32)tex->size.x, (f32)tex->size.y);
+    if(target->fixed_size.x > 0 && target->fixed_size.y > 0) {
+        return size;
+    }
+
+    return make_vector(
+        MIN(MAX(floor_f32(render_size.x * target->scale), 1.f), size.x),
+        MIN(MAX(floor_f32(render_size.y * target->scale), 1.f), size.y)
+    );
+}
+
+intern force_inline
+b32 does_render_texture_fit(Render_Texture * tex, Render_Target * target, v2_s32 size) {
+    return tex->texture != 0
+        && tex->format == target->format
+        && tex->num_mips == target->num_mips
+        && tex->size == size;
+}
+
+intern
+void free_render_texture(Render_Texture * tex) {
+    gl_state_forget_framebuffer(tex->fbo);
+    gl_state_forget_texture(tex->texture);
+    glDeleteFramebuffers(1, &tex->fbo);
+    glDeleteTextures(1, &tex->texture);
+    *tex = {};
+}
+
+intern u64 next_render_texture_generation = 1;
+
+intern
+s64 make_render_texture(Lua_Renderer * r, Render_Target * target, v2_s32 size) {
+    s64 index = -1;
+    Render_Texture * tex = 0;
+
+    ForRange(slot_index, 0, r->render_textures.watermark) {
+        auto * slot = array_get_at_index_unchecked(&r->render_textures, slot_index);
+        if(slot->texture == 0) {
+            index = slot_index;
+            tex = slot;
+            break;
+        }
+    }
+
+    if(!tex) {
+        tex = array_append(&r->render_textures, &index);
+    }
+
+    *tex = {};
+    tex->format = target->format;
+    tex->size = size;
+    tex->num_mips = target->num_mips;
+    tex->generation = next_render_texture_generation++;
+
+    auto is_float = target->format == GL_RGBA16F || target->format == GL_RGBA32F || target->format == GL_R16F;
+
+    glGenTextures(1, &tex->texture);
+    gl_state_bind_texture_2d(tex->texture);
+
+    ForRange(level, 0, tex->num_mips) {
+        auto level_w = MAX(size.x >> level, 1);
+        auto level_h = MAX(size.y >> level, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, tex->format, level_w, level_h, 0, GL_RGBA, is_float ? GL_FLOAT : GL_UNSIGNED_BYTE, 0);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex->num_mips - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, tex->num_mips > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &tex->fbo);
+    gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, tex->fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex->texture, 0);
+
+    if(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("render target '%.*s' is incomplete\n", (s32)target->name.length, target->name.str);
+    }
+
+    // NOTE(justas): so the first frame doesn't sample garbage
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    return index;
+}
+
+template<typename T>
+intern force_inline
+u64 hash_value(const T & value, u64 hash) {
+    return hash_fnv(make_string((const char*)&value, sizeof(value)), hash);
+}
+
+// NOTE(justas): covers everything a pass reads: the program, the uniform values it draws with,
+// the per frame values it actually uses and what's in its inputs. Has to be called once the
+// pass has set its own uniforms, other passes sharing the program set theirs in between.
+intern
+u64 get_render_pass_key(Lua_Renderer * r, Render_Pass * pass, Gl_Shader * shader, Render_Texture * output) {
+    auto key = hash_value(shader->id, pass->shader_hash);
+    key = hash_value(shader->untracked_uniform_version, key);
+    key = hash_value(output->generation, key);
+
+    For(shader->uniforms) {
+        key = hash_value(it->as, key);
+    }
+
+    if(shader->frame_dependencies & FRAME_DEPENDENCY_TIME) {
+        key = hash_value(shader_time, key);
+    }
+
+    if(shader->frame_dependencies & FRAME_DEPENDENCY_RESOLUTION) {
+        key = hash_value(output->size, key);
+    }
+
+    if(shader->frame_dependencies & FRAME_DEPENDENCY_MOUSE) {
+        key = hash_value(get_shader_mouse(), key);
+    }
+
+    ForRange(input_index, 0, pass->num_inputs) {
+        auto * input = pass->inputs + input_index;
+        key = hash_value(input->target_hash, key);
+
+        auto * target = table_get(&r->render_targets, input->target_hash);
+        if(!target || target->texture_index == -1) {
+            continue;
+        }
+
+        auto * tex = array_get_at_index_unchecked(&r->render_textures, target->texture_index);
+        key = hash_value(tex->generation, key);
+        key = hash_value(target->version, key);
+    }
+
+    return key;
+}
+
+struct Render_Target_Lifetime {
+    s64 first_use;
+    s64 last_use;
+};
+
+// NOTE(justas): runs what gl_pass recorded this frame. Passes run in the order they were
+// recorded, each one reading the latest contents of its inputs. Passes whose output nobody
+// ends up reading are culled, transient targets share textures when their lifetimes
+// (first to last pass that touches them) don't overlap.
+intern
+void run_render_graph(Lua_Renderer * r) {
+    auto * passes = &r->render_passes;
+    if(passes->watermark == 0) {
+        return;
+    }
+
+    auto * temp = r->temp_alloc;
+
+    r->num_drawn_passes = 0;
+    r->num_cached_passes = 0;
+
+    // NOTE(justas): walking backwards, `wanted` holds the transient targets a later needed
+    // pass is going to read. Writing a target satisfies whoever wanted it.
+    {
+        auto wanted = make_table<b32>(16, temp, "render graph wanted targets"_S);
+
+        for(s64 index = passes->watermark - 1; index >= 0; index--) {
+            auto * pass = array_get_at_index_unchecked(passes, index);
+            Render_Target * output = 0;
+
+            if(pass->output_hash != 0) {
+                output = table_get(&r->render_targets, pass->output_hash);
+                if(!output) {
+                    printf("pass '%.*s' draws into a render target that doesn't exist\n", (s32)pass->name.length, pass->name.str);
+                    pass->is_needed = false;
+                    continue;
+                }
+            }
+
+            pass->is_needed = !output || !output->is_transient || table_remove(&wanted, pass->output_hash);
+
+            if(!pass->is_needed) {
+                continue;
+            }
+
+            ForRange(input_index, 0, pass->num_inputs) {
+                *table_insert(&wanted, pass->inputs[input_index].target_hash) = true;
+            }
+        }
+    }
+
+    For(r->render_textures) {
+        it->is_used_this_frame = false;
+    }
+
+    For(r->render_targets) {
+        auto * target = &it->value;
+
+        if(target->is_transient) {
+            target->texture_index = -1;
+            target->first_use = -1;
+            continue;
+        }
+
+        auto size = get_render_target_size(target);
+        auto * tex = target->texture_index != -1 ? array_get_at_index_unchecked(&r->render_textures, target->texture_index) : 0;
+
+        if(!tex || !tex->is_persistent || !does_render_texture_fit(tex, target, size)) {
+            if(tex && tex->is_persistent) {
+                free_render_texture(tex);
+            }
+
+            target->texture_index = make_render_texture(r, target, size);
+            tex = array_get_at_index_unchecked(&r->render_textures, target->texture_index);
+            tex->is_persistent = true;
+        }
+
+        tex->is_used_this_frame = true;
+    }
+
+    {
+        auto lifetimes = make_table<Render_Target_Lifetime>(16, temp, "render graph lifetimes"_S);
+
+        auto touch = [&](u64 target_hash, s64 pass_index) {
+            b32 did_insert = false;
+            auto * lifetime = table_insert(&lifetimes, target_hash, &did_insert);
+            if(did_insert) {
+                lifetime->first_use = pass_index;
+            }
+            lifetime->last_use = pass_index;
+        };
+
+        ForRange(index, 0, passes->watermark) {
+            auto * pass = array_get_at_index_unchecked(passes, index);
+            if(!pass->is_needed) {
+                continue;
+            }
+
+            if(pass->output_hash != 0) {
+                touch(pass->output_hash, index);
+            }
+
+            ForRange(input_index, 0, pass->num_inputs) {
+                touch(pass->inputs[input_index].target_hash, index);
+            }
+        }
+
+        // NOTE(justas): hand out textures in the order targets come alive so a texture
+        // whose previous occupant is done can be picked up by the next one.
+        ForRange(index, 0, passes->watermark) {
+            For(lifetimes) {
+                auto * lifetime = &it->value;
+                if(lifetime->first_use != index) {
+                    continue;
+                }
+
+                auto * target = table_get(&r->render_targets, it->hash);
+                if(!target || !target->is_transient) {
+                    continue;
+                }
+
+                auto size = get_render_target_size(target);
+
+                ForRange(tex_index, 0, r->render_textures.watermark) {
+                    auto * tex = array_get_at_index_unchecked(&r->render_textures, tex_index);
+
+                    if(tex->is_persistent || !does_render_texture_fit(tex, target, size)) {
+                        continue;
+                    }
+
+                    if(tex->is_used_this_frame && tex->last_use >= index) {
+                        continue;
+                    }
+
+                    target->texture_index = tex_index;
+                    break;
+                }
+
+                if(target->texture_index == -1) {
+                    target->texture_index = make_render_texture(r, target, size);
+                }
+
+                auto * tex = array_get_at_index_unchecked(&r->render_textures, target->texture_index);
+                tex->is_used_this_frame = true;
+                tex->last_use = lifetime->last_use;
+                target->first_use = lifetime->first_use;
+            }
+        }
+    }
+
+    ForRange(index, 0, passes->watermark) {
+        auto * pass = array_get_at_index_unchecked(passes, index);
+        if(!pass->is_needed) {
+            continue;
+        }
+
+        auto * shader = table_get(&r->shaders, pass->shader_hash);
+        if(!shader || shader->id == -1) {
+            continue;
+        }
+
+        v2 resolution = render_size;
+        Render_Target * output = 0;
+        Render_Texture * output_tex = 0;
+
+        if(pass->output_hash != 0) {
+            output = table_get(&r->render_targets, pass->output_hash);
+            output_tex = array_get_at_index_unchecked(&r->render_textures, output->texture_index);
+            resolution = get_render_target_draw_size(output, output_tex);
+        }
+
+        // NOTE(justas): the pass's own uniforms go up before the cache check so the key sees
+        // them. Values that didn't change since the last upload don't reach GL.
+        gl_state_use_program(shader->id);
+        r->active_shader_hash = pass->shader_hash;
+
+        set_default_uniforms(shader, resolution);
+
+        // NOTE(justas): <sampler>Scale maps 0..1 uvs onto the part of the input that was
+        // drawn this frame, it's below 1 while dynamic resolution is scaling down.
+        ForRange(input_index, 0, pass->num_inputs) {
+            auto * input = pass->inputs + input_index;
+            set_uniform_s32(shader, temp_cstring(input->uniform, temp), (s32)input_index);
+
+            auto * target = table_get(&r->render_targets, input->target_hash);
+            if(!target || target->texture_index == -1) {
+                continue;
+            }
+
+            auto * tex = array_get_at_index_unchecked(&r->render_textures, target->texture_index);
+            auto draw_size = get_render_target_draw_size(target, tex);
+
+            char scale_name[128];
+            snprintf(scale_name, sizeof(scale_name), "%.*sScale", (s32)input->uniform.length, input->uniform.str);
+            set_uniform_v2_f32(shader, scale_name, make_vector(draw_size.x / tex->size.x, draw_size.y / tex->size.y), false);
+        }
+
+        u64 pass_key = 0;
+
+        if(output) {
+            pass_key = get_render_pass_key(r, pass, shader, output_tex);
+
+            // NOTE(justas): only persistent targets still hold what we drew last frame.
+            if(!output->is_transient &&
+                output->last_pass_hash == pass->name_hash &&
+                output->last_pass_key == pass_key
+            ) {
+                r->num_cached_passes++;
+                continue;
+            }
+
+            gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, output_tex->fbo);
+
+            // NOTE(justas): a transient target starts the frame empty, and anything left in
+            // the texture by a target it was aliased to isn't ours. Later passes that write the
+            // same target draw on top of what the earlier ones left.
+            if(output->is_transient &&
+                (index == output->first_use || output_tex->last_target_hash != pass->output_hash)
+            ) {
+                glClear(GL_COLOR_BUFFER_BIT);
+            }
+
+            output_tex->last_target_hash = pass->output_hash;
+        }
+        else {
+            gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, default_framebuffer);
+        }
+
+        auto zone = profiler_begin_gpu(pass->name);
+
+        gl_state_viewport(0, 0, resolution.x, resolution.y);
+
+        ForRange(input_index, 0, pass->num_inputs) {
+            auto * input = pass->inputs + input_index;
+            auto * target = table_get(&r->render_targets, input->target_hash);
+
+            gl_state_active_texture((s32)input_index);
+
+            if(!target || target->texture_index == -1) {
+                gl_state_bind_texture_2d(0);
+            }
+            else {
+                gl_state_bind_texture_2d(array_get_at_index_unchecked(&r->render_textures, target->texture_index)->texture);
+            }
+        }
+
+        draw_quad();
+        r->num_drawn_passes++;
+
+        if(output) {
+            output->version++;
+
+            output->last_pass_hash = pass->name_hash;
+            output->last_pass_key = pass_key;
+
+            if(output->num_mips > 1) {
+                gl_state_active_texture(0);
+                gl_state_bind_texture_2d(output_tex->texture);
+                glGenerateMipmap(GL_TEXTURE_2D);
+            }
+        }
+
+        profiler_end(zone);
+    }
+
+    // NOTE(justas): e.g a target that got resized or isn't drawn into anymore.
+    For(r->render_textures) {
+        if(it->texture != 0 && !it->is_used_this_frame) {
+            free_render_texture(it);
+        }
+    }
+
+    gl_state_active_texture(0);
+    gl_state_bind_texture_2d(0);
+    gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, default_framebuffer);
+    gl_state_viewport(0, 0, render_size.x, render_size.y);
+
+    array_clear(passes);
+}
+
+intern
+u32 get_current_render_state() {
+    u32 state = 0;
+    if(gl_state.blend == -1 ? glIsEnabled(GL_BLEND) : gl_state.blend) state |= RENDER_STATE_BLEND;
+    if(gl_state.srgb == -1 ? glIsEnabled(GL_FRAMEBUFFER_SRGB) : gl_state.srgb) state |= RENDER_STATE_SRGB;
+    return state;
+}
+
+intern
+void apply_render_state(u32 from, u32 to) {
+    auto changed = from ^ to;
+
+    if(changed & RENDER_STATE_BLEND) {
+        gl_state_set_blend(to & RENDER_STATE_BLEND);
+        if(to & RENDER_STATE_BLEND) {
+            gl_state_blend_func_separate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
+        }
+    }
+
+    if(changed & RENDER_STATE_SRGB) {
+        gl_state_set_srgb(to & RENDER_STATE_SRGB);
+    }
+}
+
+intern
+void begin_render_batch(Lua_Renderer * r) {
+    auto * batch = &r->batch;
+    if(batch->is_recording) {
+        return;
+    }
+
+    batch->is_recording = true;
+    batch->commands = make_array<Render_Command>(64, r->temp_alloc, "render batch"_S);
+    batch->shader_hash = r->active_shader_hash;
+    batch->state = get_current_render_state();
+    batch->executed_state = batch->state;
+}
+
+intern
+Render_Command * record_render_command(Render_Batch * batch, RENDER_COMMAND_ type) {
+    auto * cmd = array_append(&batch->commands);
+    *cmd = {};
+    cmd->type = type;
+    cmd->shader_hash = batch->shader_hash;
+    cmd->state = batch->state;
+
+    return cmd;
+}
+
+// NOTE(justas): keeps the commands in order and only works out which program binds are
+// needed, adjacent commands on the same program share one. Commands for a shader that's
+// still compiling or failed get dropped, same as the immediate calls skip them.
+intern
+void resolve_render_batch(Render_Batch * batch, Table<Gl_Shader> * shaders, u64 bound_shader_hash) {
+    auto is_bound_usable = false;
+    if(bound_shader_hash != 0) {
+        auto * bound = table_get(shaders, bound_shader_hash);
+        is_bound_usable = bound && bound->id != -1;
+    }
+
+    For(batch->commands) {
+        it->flags = 0;
+
+        if(it->type == RENDER_COMMAND_CLEAR_COLOR || 
+           it->type == RENDER_COMMAND_DEFAULT_FB || 
+           it->type == RENDER_COMMAND_DEFAULT_VIEWPORT
+        ) {
+            continue;
+        }
+
+        if(it->shader_hash != bound_shader_hash) {
+            auto * shader = table_get(shaders, it->shader_hash);
+
+            if(!shader || shader->id == -1) {
+                it->flags |= RENDER_COMMAND_DROPPED;
+                batch->num_dropped_commands++;
+                continue;
+            }
+
+            it->flags |= RENDER_COMMAND_SWITCH_PROGRAM;
+            bound_shader_hash = it->shader_hash;
+            is_bound_usable = true;
+            batch->num_program_switches++;
+        }
+
+        if(!is_bound_usable) {
+            it->flags |= RENDER_COMMAND_DROPPED;
+            batch->num_dropped_commands++;
+        }
+    }
+}
+
+// NOTE(justas): runs what's been recorded so far and keeps recording.
+intern
+void flush_render_batch(Lua_Renderer * r) {
+    auto * batch = &r->batch;
+    if(!batch->is_recording || batch->commands.watermark == 0) {
+        return;
+    }
+
+    auto zone = profiler_begin_gpu("render batch"_S);
+
+    resolve_render_batch(batch, &r->shaders, r->active_shader_hash);
+
+    gl_state_bind_vertex_array(quad_vao);
+    gl_state_bind_array_buffer(quad_vbo);
+
+    auto applied_state = batch->executed_state;
+    u64 bound_shader_hash = r->active_shader_hash;
+    Gl_Shader * bound_shader = r->get_active_shader();
+
+    For(batch->commands) {
+        batch->num_commands++;
+
+        if(it->type == RENDER_COMMAND_CLEAR_COLOR) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            continue;
+        }
+
+        if(it->type == RENDER_COMMAND_DEFAULT_FB) {
+            gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, default_framebuffer);
+            continue;
+        }
+
+        if(it->type == RENDER_COMMAND_DEFAULT_VIEWPORT) {
+            gl_state_viewport(0,0,render_size.x, render_size.y);
+            continue;
+        }
+
+        if(it->flags & RENDER_COMMAND_DROPPED) {
+            continue;
+        }
+
+        if(it->flags & RENDER_COMMAND_SWITCH_PROGRAM) {
+            bound_shader = table_get(&r->shaders, it->shader_hash);
+            bound_shader_hash = it->shader_hash;
+            gl_state_use_program(bound_shader->id);
+        }
+
+        if(it->type == RENDER_COMMAND_UNIFORM) {
+            if(it->uniform_type == GL_FLOAT) {
+                set_uniform_f32(bound_shader, it->uniform_name, it->uniform_value.x);
+            }
+            else {
+                set_uniform_v2_f32(bound_shader, it->uniform_name, it->uniform_value);
+            }
+        }
+        else if(it->type == RENDER_COMMAND_DEFAULT_UNIFORMS) {
+            set_default_uniforms(bound_shader, render_size);
+        }
+        else if(it->type == RENDER_COMMAND_DRAW_QUAD) {
+            apply_render_state(applied_state, it->state);
+            applied_state = it->state;
+
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    }
+
+    // NOTE(justas): leave GL the way the script's calls would have.
+    apply_render_state(applied_state, batch->state);
+    batch->executed_state = batch->state;
+
+    if(batch->shader_hash != bound_shader_hash) {
+        auto * shader = table_get(&r->shaders, batch->shader_hash);
+        if(shader && shader->id != -1) {
+            gl_state_use_program(shader->id);
+        }
+    }
+    r->active_shader_hash = batch->shader_hash;
+
+    array_clear(&batch->commands);
+    profiler_end(zone);
+}
+
+intern
+void submit_render_batch(Lua_Renderer * r) {
+    flush_render_batch(r);
+    r->batch.is_recording = false;
+    r->batch.commands = {};
+}
+
+intern 
+b32 try_load_renderer(
+        String script,
+        Lua_Renderer * out_renderer,
+        String * out_error
+        
+) {
+    auto cstring_script = temp_cstring(script, &temp_allocator);
+
+    sol::state temp_lua;
+
+    auto script_result = temp_lua.script(cstring_script, [](lua_State*, sol::protected_function_result pfr) {
+        return pfr;
+
+    }, "render script");
+
+    if(!script_result.valid()) {
+        sol::error e = script_result;
+        *out_error = make_string(e.what());
+        return false;
+    }
+
+    sol::protected_function render_fn = temp_lua["render"];
+    if(!render_fn.valid()) {
+        *out_error = "the script doesn't define a render function"_S;
+        return false;
+    }
+
+    *out_renderer = {};
+    auto & our_rend = *out_renderer;
+    our_rend.temp_alloc = &temp_allocator;
+    our_rend.alloc = (Memory_Allocator*)memory_allocator_allocate_aligned(&main_thread_allocator, sizeof(Memory_Allocator), alignof(Memory_Allocator), "renderer allocator").data;
+    *our_rend.alloc = make_pool_memory_allocator(KILOBYTES(64), MAIN_THREAD_POOL_RESERVE_SIZE);
+    our_rend.asset_catalogue = make_table<Asset_Entry>(8, our_rend.alloc, "asset catalogue"_S);
+    our_rend.shader_parts = make_table<Gl_Shader_Part>(8, our_rend.alloc, "shader parts"_S);
+    our_rend.shader_part_keys = make_table<u64>(8, our_rend.alloc, "shader part keys"_S);
+    our_rend.shaders = make_table<Gl_Shader>(8, our_rend.alloc, "shaders"_S);
+    our_rend.render_targets = make_table<Render_Target>(8, our_rend.alloc, "render targets"_S);
+    our_rend.render_textures = make_array<Render_Texture>(8, our_rend.alloc, "render textures"_S);
+    our_rend.render_passes = make_array<Render_Pass>(16, our_rend.alloc, "render passes"_S);
+    our_rend.lua = std::move(temp_lua);
+    our_rend.render_fn = std::move(render_fn);
+    our_rend.needs_free = true;
+    our_rend.can_render = true;
+
+    our_rend.frame = (Lua_Frame_State*)memory_allocator_allocate(our_rend.alloc, sizeof(Lua_Frame_State), "lua frame state").data;
+    *our_rend.frame = {};
+
+    auto & lua = our_rend.lua;
+
+    lua.open_libraries(sol::lib::base);
+
+    lua.new_usertype<Lua_Frame_State>("Frame_State",
+        "dt", sol::readonly(&Lua_Frame_State::dt),
+        "time", sol::readonly(&Lua_Frame_State::time),
+        "resolution_x", sol::readonly(&Lua_Frame_State::resolution_x),
+        "resolution_y", sol::readonly(&Lua_Frame_State::resolution_y),
+        "index", sol::readonly(&Lua_Frame_State::index)
+    );
+    lua["frame"] = our_rend.frame;
+
+    // NOTE(justas): dt, _time and _resolution_x/y used to be globals we set every frame. Only
+    // scripts that still read them pay for the lookup now.
+    lua.script(R"(
+        local frame = frame
+        local legacy = {
+            dt = function() return frame.dt end,
+            _time = function() return frame.time end,
+            _resolution_x = function() return frame.resolution_x end,
+            _resolution_y = function() return frame.resolution_y end,
+        }
+
+        setmetatable(_G, { __index = function(_, key)
+            local get = legacy[key]
+            if get then return get() end
+        end })
+    )");
+    lua["GL_VERTEX"] = GL_VERTEX_SHADER;
+    lua["GL_FRAGMENT"] = GL_FRAGMENT_SHADER;
+
+    lua["gl_set_default_uniforms"] = [](Lua_Renderer * r) {
+        if(r->batch.is_recording) {
+            record_render_command(&r->batch, RENDER_COMMAND_DEFAULT_UNIFORMS);
+            return;
+        }
+
+        auto * shader = r->get_active_shader();
+        if(!shader) {
+            return;
+        }
+
+        set_default_uniforms(shader, render_size);
+    };
+
+    lua["gl_load_shader_part"] = [](Lua_Renderer * r, const char * cname, s32 type, const char * dir) {
+        auto name = make_string(cname);
+        auto path_key = get_shader_part_key(type, hash_fnv(make_string(dir)));
+
+        auto * asset = r->get_asset(path_key, dir);
+        auto * current_key = table_insert_or_initialize_new(&r->shader_part_keys, path_key);
+
+        if(!does_asset_need_loading(asset) && *current_key != 0) {
+            return (void*)*current_key;
+        }
+
+        auto read = plat_fs_read_entire_file(dir, r->temp_alloc);
+
+        if(read.did_succeed && !did_asset_content_change(asset, read.as_string) && *current_key != 0) {
+            printf("shader '%s' is unchanged, not reloading\n", cname);
+            return (void*)*current_key;
+        }
+
+        u64 key;
+        Gl_Shader_Part * part;
+
+        if(!read.did_succeed) {
+            // NOTE(justas): so the next successful read counts as a change
+            asset->has_content_hash = false;
+            printf("failed to read shader %s\n", dir);
+
+            // NOTE(justas): a part of its own that never loads, programs report its error.
+            key = get_shader_part_key(type, path_key);
+            part = table_insert_or_initialize_new(&r->shader_parts, key);
+            part->name = name;
+            part->type = type;
+            part->comparison_hash = key;
+            string_free(&main_thread_allocator, &part->error);
+            part->error = make_string_copy("failed to read shader"_S, &main_thread_allocator).string;
+        }
+        else {
+            key = get_shader_part_key(type, asset->content_hash);
+            part = table_insert_or_initialize_new(&r->shader_parts, key);
+
+            if(part->is_loaded) {
+                r->num_shared_part_loads++;
+                printf("shader '%s' has the same source as '%.*s', sharing it\n", cname, (s32)part->name.length, part->name.str);
+            }
+            else {
+                part->name = name;
+                part->type = type;
+                part->source = make_string_copy(read.as_string, &main_thread_allocator).string;
+                part->source_hash = asset->content_hash;
+                part->comparison_hash = key;
+                part->is_loaded = true;
+            }
+        }
+
+        if(*current_key != key) {
+            part->ref_count++;
+
+            if(*current_key != 0) {
+                release_shader_part(r, *current_key);
+            }
+            *current_key = key;
+        }
+
+        return (void*)key;
+    };
+
+    lua["find_file_that_starts_with_in_folder"] = [](Lua_Renderer * r, const char * cstarts_with, const char * in_folder) {
+        auto * temp = r->temp_alloc;
+        auto files = get_all_files_in_directory(in_folder, temp);
+
+        auto starts_with = make_string(cstarts_with);
+
+        For(files) {
+            if(!it->is_file) {
+                continue;
+            }
+            if(string_starts_with(it->name, starts_with)) {
+                return temp_cstring(it->name, temp);
+            }
+        }
+
+        return "file_not_found";
+    };
+
+    lua["gl_use_shader"] = [](Lua_Renderer * r, void * void_shader_hash) {
+        auto shader_hash = (u64)void_shader_hash;
+        auto * shader = table_insert_or_initialize_new(&r->shaders, shader_hash);
+
+        if(shader->id == -1) {
+            return;
+        }
+
+        if(r->batch.is_recording) {
+            if(r->batch.shader_hash != shader_hash) {
+                r->batch.num_requested_program_switches++;
+            }
+            r->batch.shader_hash = shader_hash;
+            return;
+        }
+
+        auto zone = profiler_begin_gpu("gl_use_shader"_S);
+        gl_state_use_program(shader->id);
+        r->active_shader_hash = shader_hash;
+        profiler_end(zone);
+    };
+
+    lua["target_fps"] = [](Lua_Renderer * r, f32 target_fps) {
+        r->target_fps = target_fps;
+    };
+
+    lua["dynamic_resolution"] = [](Lua_Renderer * r, f32 min_scale, f32 max_scale) {
+        clamp(&min_scale, .1f, 1.f);
+        clamp(&max_scale, min_scale, 1.f);
+
+        r->wants_dynamic_resolution = true;
+        r->min_resolution_scale = min_scale;
+        r->max_resolution_scale = max_scale;
+    };
+
+    lua["gl_load_shader"] = [](Lua_Renderer * r, const char * cname, sol::table t) {
+
+        auto name = make_string(cname);
+        auto hash = hash_fnv(name);
+
+        auto * shader = table_insert_or_initialize_new(&r->shaders, hash);
+        shader->name = name;
+
+        auto needs_reload = false;
+
+        auto has_hash_mismatch = false;
+        auto num_parts = 0;
+        for(auto & kvp : t) {
+            num_parts++;
+
+            auto part_hash = (u64)kvp.second.as<void*>();
+            auto * part = table_insert_or_initialize_new(&r->shader_parts, part_hash);
+
+            auto does_have_this_hash = false;
+            for(auto * it : shader->part_hashes) {
+                if(*it == part->comparison_hash) {
+                    does_have_this_hash = true;
+                    break;
+                }
+            }
+
+            if(!does_have_this_hash) {
+                has_hash_mismatch = true;
+                break;
+            }
+        }
+
+        if(has_hash_mismatch) {
+            needs_reload = true;
+        }
+        else if(shader->part_hashes.watermark <= 0 && num_parts > 0) {
+            needs_reload = true;
+        }
+
+        if(needs_reload) {
+            For(shader->part_hashes) {
+                release_shader_part(r, *it);
+            }
+
+            array_clear(&shader->part_hashes);
+            array_clear(&shader->pending_parts);
+
+            // NOTE(justas): superseded by this reload
+            if(shader->pending_id != -1) {
+                glDeleteProgram(shader->pending_id);
+                shader->pending_id = -1;
+            }
+
+            auto id = glCreateProgram();
+
+            printf("reloading shader %s\n", cname);
+
+            auto binary_key = program_binary_cache.driver_hash;
+
+            for(auto & kvp : t) {
+                auto part_hash = (u64)kvp.second.as<void*>();
+                auto * part = table_insert_or_initialize_new(&r->shader_parts, part_hash);
+                *array_append(&shader->part_hashes) = part->comparison_hash;
+                *array_append(&shader->pending_parts) = part_hash;
+                part->ref_count++;
+
+                if(!part->is_loaded) {
+                    printf("gl_load_shader was passed an uninitialized shader %llu!\n", part_hash);
+
+                    string_free(&main_thread_allocator, &shader->error);
+                    auto a = make_string_copy(part->error, &main_thread_allocator);
+                    shader->error = a.string;
+
+                    glDeleteProgram(id);
+                    return (void*)hash;
+                }
+
+                binary_key = get_program_binary_key(binary_key, part);
+            }
+
+            if(try_load_program_binary(binary_key, id)) {
+                printf("loaded shader %s from the program binary cache\n", cname);
+
+                string_free(&main_thread_allocator, &shader->error);
+                install_shader_program(r, hash, shader, id);
+            }
+            else {
+                for(auto & kvp : t) {
+                    auto part_hash = (u64)kvp.second.as<void*>();
+                    auto * part = table_insert_or_initialize_new(&r->shader_parts, part_hash);
+
+                    if(!try_submit_shader_part(part)) {
+                        string_free(&main_thread_allocator, &shader->error);
+                        auto a = make_string_copy(part->error, &main_thread_allocator);
+                        shader->error = a.string;
+
+                        glDeleteProgram(id);
+                        return (void*)hash;
+                    }
+
+                    glAttachShader(id, part->id);
+                }
+
+                TRACE_ZONE("gl_load_shader link");
+
+                glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+                glLinkProgram(id);
+
+                shader->pending_id = id;
+                shader->pending_binary_key = binary_key;
+            }
+        }
+
+        if(shader->pending_id != -1 && is_shader_program_ready(shader->pending_id)) {
+            finish_pending_shader_program(r, hash, shader);
+        }
+
+        return (void*)hash;
+    };
+
+    lua["gl_enable_alpha_blend"] = [](Lua_Renderer * r) {
+        if(r->batch.is_recording) {
+            r->batch.state |= RENDER_STATE_BLEND;
+            return;
+        }
+
+        gl_state_set_blend(true);
+        gl_state_blend_func_separate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
+    };
+    lua["gl_disable_alpha_blend"] = [](Lua_Renderer * r) {
+        if(r->batch.is_recording) {
+            r->batch.state &= ~RENDER_STATE_BLEND;
+            return;
+        }
+
+        gl_state_set_blend(false);
+    };
+
+    lua["gl_clear_color"] = [](Lua_Renderer * r) {
+        if(r->batch.is_recording) {
+            record_render_command(&r->batch, RENDER_COMMAND_CLEAR_COLOR);
+            return;
+        }
+
+        auto zone = profiler_begin_gpu("gl_clear_color"_S);
+        glClear(GL_COLOR_BUFFER_BIT);
+        profiler_end(zone);
+    };
+
+    lua["gl_default_viewport"] = [](Lua_Renderer * r) {
+        if(r->batch.is_recording) {
+            record_render_command(&r->batch, RENDER_COMMAND_DEFAULT_VIEWPORT);
+            return;
+        }
+
+        gl_state_viewport(0,0,render_size.x, render_size.y);
+    };
+
+    lua["gl_default_fb"] = [](Lua_Renderer * r ) {
+        if(r->batch.is_recording) {
+            record_render_command(&r->batch, RENDER_COMMAND_DEFAULT_FB);
+            return;
+        }
+
+        gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, default_framebuffer);
+    };
+
+    lua["gl_draw_quad"] = [](Lua_Renderer * r) {
+        if(r->batch.is_recording) {
+            record_render_command(&r->batch, RENDER_COMMAND_DRAW_QUAD);
+            return;
+        }
+
+        auto zone = profiler_begin_gpu("gl_draw_quad"_S);
+        draw_quad();
+        profiler_end(zone);
+    };
+
+    // NOTE(justas): options are { width = , height = } for a fixed size or { scale = } relative
+    // to the window (default 1), format = "rgba8" | "srgb8" | "rgba16f" | "rgba32f" | "r16f",
+    // mips = N and transient = true for targets that are only read in the frame they're drawn.
+    lua["gl_render_target"] = [](Lua_Renderer * r, const char * cname, sol::table options) {
+        auto name = make_string(cname);
+        auto hash = hash_fnv(name);
+
+        auto * target = table_insert_or_initialize_new(&r->render_targets, hash);
+        target->name = name;
+        target->fixed_size = make_vector((f32)options.get_or("width", 0.0), (f32)options.get_or("height", 0.0));
+        target->scale = (f32)options.get_or("scale", 1.0);
+        target->is_transient = options.get_or("transient", false);
+        target->format = GL_RGBA8;
+
+        auto format = options.get<sol::object>("format");
+        if(format.valid() && !try_parse_render_target_format(make_string(format.as<const char*>()), &target->format)) {
+            printf("render target '%s' has an unknown format, using rgba8\n", cname);
+        }
+
+        auto size = get_render_target_size(target);
+        auto max_mips = log2_s32(MAX(size.x, size.y)) + 1;
+        target->num_mips = MIN(MAX((s32)options.get_or("mips", 1.0), 1), max_mips);
+
+        return (void*)hash;
+    };
+
+    // NOTE(justas): records a full screen quad drawn with `shader` into `output` (nil for the
+    // default framebuffer). `inputs` maps sampler2D uniform names to render targets. Nothing
+    // is drawn until gl_run_passes.
+    lua["gl_pass"] = [](Lua_Renderer * r, const char * cname, void * shader_hash, sol::object output, sol::table inputs) {
+        auto * pass = array_append(&r->render_passes);
+        *pass = {};
+        pass->name = make_string_copy_temporary(cname, r->temp_alloc);
+        pass->name_hash = hash_fnv(pass->name);
+        pass->shader_hash = (u64)shader_hash;
+
+        if(output.valid()) {
+            pass->output_hash = (u64)output.as<void*>();
+        }
+
+        for(auto & kvp : inputs) {
+            if(pass->num_inputs >= MAX_RENDER_PASS_INPUTS) {
+                printf("pass '%s' has more than %d inputs, ignoring the rest\n", cname, MAX_RENDER_PASS_INPUTS);
+                break;
+            }
+
+            auto * input = pass->inputs + pass->num_inputs++;
+            input->uniform = make_string_copy_temporary(kvp.first.as<const char*>(), r->temp_alloc);
+            input->target_hash = (u64)kvp.second.as<void*>();
+        }
+    };
+
+    lua["gl_run_passes"] = [](Lua_Renderer * r) {
+        // NOTE(justas): the graph talks to GL directly, so whatever came before has to go first.
+        flush_render_batch(r);
+        run_render_graph(r);
+
+        if(r->batch.is_recording) {
+            r->batch.shader_hash = r->active_shader_hash;
+        }
+    };
+
+    lua["gl_begin_batch"] = [](Lua_Renderer * r) {
+        begin_render_batch(r);
+    };
+
+    lua["gl_submit_batch"] = [](Lua_Renderer * r) {
+        submit_render_batch(r);
+    };
+
+    lua["gl_uniform_f32"] = [](Lua_Renderer * r, const char * uniform, f32 num) {
+        if(r->batch.is_recording) {
+            auto * cmd = record_render_command(&r->batch, RENDER_COMMAND_UNIFORM);
+            cmd->uniform_name = temp_cstring(make_string(uniform), r->temp_alloc);
+            cmd->uniform_type = GL_FLOAT;
+            cmd->uniform_value = {num, 0};
+            return;
+        }
+
+        auto * shader = r->get_active_shader();
+        if(shader) {
+            set_uniform_f32(shader, uniform, num);
+        }
+    };
+
+    lua["gl_uniform_v2_f32"] = [](Lua_Renderer * r, const char * uniform, f32 x, f32 y) {
+        v2 v = {x,y};
+
+        if(r->batch.is_recording) {
+            auto * cmd = record_render_command(&r->batch, RENDER_COMMAND_UNIFORM);
+            cmd->uniform_name = temp_cstring(make_string(uniform), r->temp_alloc);
+            cmd->uniform_type = GL_FLOAT_VEC2;
+            cmd->uniform_value = v;
+            return;
+        }
+
+        auto * shader = r->get_active_shader();
+        if(shader) {
+            set_uniform_v2_f32(shader, uniform, v);
+        }
+    };
+
+    lua["gl_enable_srgb"] = [](Lua_Renderer * r) {
+        if(r->batch.is_recording) {
+            r->batch.state |= RENDER_STATE_SRGB;
+            return;
+        }
+
+        gl_state_set_srgb(true);
+    };
+
+    lua["gl_disable_srgb"] = [](Lua_Renderer * r) {
+        if(r->batch.is_recording) {
+            r->batch.state &= ~RENDER_STATE_SRGB;
+            return;
+        }
+
+        gl_state_set_srgb(false);
+    };
+
+
+    return true;
+}
+
+// NOTE(justas): GL_TIME_ELAPSED queries in a ring, results are picked up a couple of
+// frames later once they're available so we never wait on the gpu.
+#define NUM_GPU_TIMER_QUERIES 4
+
+struct Gpu_Timer {
+    u32 queries[NUM_GPU_TIMER_QUERIES];
+    b32 is_in_flight[NUM_GPU_TIMER_QUERIES];
+    s64 next;
+    b32 is_measuring;
+};
+
+intern
+void make_gpu_timer(Gpu_Timer * timer) {
+    *timer = {};
+    glGenQueries(NUM_GPU_TIMER_QUERIES, timer->queries);
+}
+
+intern
+void free_gpu_timer(Gpu_Timer * timer) {
+    glDeleteQueries(NUM_GPU_TIMER_QUERIES, timer->queries);
+    *timer = {};
+}
+
+intern
+void gpu_timer_begin(Gpu_Timer * timer) {
+    // NOTE(justas): the gpu is more than a ring behind, skip measuring this one.
+    if(timer->is_in_flight[timer->next]) {
+        timer->is_measuring = false;
+        return;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, timer->queries[timer->next]);
+    timer->is_measuring = true;
+}
+
+intern
+void gpu_timer_end(Gpu_Timer * timer) {
+    if(!timer->is_measuring) {
+        return;
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+    timer->is_in_flight[timer->next] = true;
+    timer->next = (timer->next + 1) % NUM_GPU_TIMER_QUERIES;
+    timer->is_measuring = false;
+}
+
+// NOTE(justas): gives back the newest finished measurement, if there is one.
+intern
+b32 gpu_timer_collect(Gpu_Timer * timer, f64 * out_seconds) {
+    auto did_collect = false;
+
+    ForRange(index, 0, NUM_GPU_TIMER_QUERIES) {
+        auto slot = (timer->next + index) % NUM_GPU_TIMER_QUERIES;
+        if(!timer->is_in_flight[slot]) {
+            continue;
+        }
+
+        s32 is_available = GL_FALSE;
+        glGetQueryObjectiv(timer->queries[slot], GL_QUERY_RESULT_AVAILABLE, &is_available);
+        if(!is_available) {
+            break;
+        }
+
+        u64 nanoseconds = 0;
+        glGetQueryObjectui64v(timer->queries[slot], GL_QUERY_RESULT, &nanoseconds);
+        timer->is_in_flight[slot] = false;
+
+        *out_seconds = (f64)nanoseconds / 1000000000.0;
+        did_collect = true;
+    }
+
+    return did_collect;
+}
+
+// NOTE(justas): renders the frame into a window sized offscreen buffer, but only into its
+// bottom left render_size corner, then stretches that over the window. Scaled render targets
+// work the same way, so changing the scale never reallocates anything, the scripts just see
+// a smaller render_size.
+#define RESOLUTION_SCALE_STEP .05f
+#define RESOLUTION_GPU_BUDGET .85 // NOTE(justas): of the frame time, leaves room for imgui and the swap
+#define RESOLUTION_GPU_TIME_SMOOTHING .1
+
+struct Resolution_Controller {
+    b32 is_active;
+    f32 scale;
+    f64 average_gpu_time;
+
+    u32 fbo;
+    u32 color_rbo;
+    v2 fbo_size;
+
+    Gpu_Timer timer;
+};
+
+intern
+void resolution_controller_start(Resolution_Controller * ctrl) {
+    *ctrl = {};
+    ctrl->scale = 1;
+    make_gpu_timer(&ctrl->timer);
+
+    glGenFramebuffers(1, &ctrl->fbo);
+    glGenRenderbuffers(1, &ctrl->color_rbo);
+}
+
+intern
+void resolution_controller_stop(Resolution_Controller * ctrl) {
+    free_gpu_timer(&ctrl->timer);
+    gl_state_forget_framebuffer(ctrl->fbo);
+    glDeleteFramebuffers(1, &ctrl->fbo);
+    glDeleteRenderbuffers(1, &ctrl->color_rbo);
+    *ctrl = {};
+}
+
+intern
+void resolution_controller_update(Resolution_Controller * ctrl, Lua_Renderer * r) {
+    ctrl->is_active = r->wants_dynamic_resolution;
+
+    if(!ctrl->is_active) {
+        ctrl->scale = 1;
+        ctrl->average_gpu_time = 0;
+        render_size = window_size;
+        return;
+    }
+
+    if(ctrl->fbo_size.x != window_size.x || ctrl->fbo_size.y != window_size.y) {
+        ctrl->fbo_size = window_size;
+
+        glBindRenderbuffer(GL_RENDERBUFFER, ctrl->color_rbo);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, window_size.x, window_size.y);
+
+        gl_state_bind_framebuffer(GL_FRAMEBUFFER, ctrl->fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ctrl->color_rbo);
+    }
+
+    f64 gpu_time;
+    if(gpu_timer_collect(&ctrl->timer, &gpu_time)) {
+        if(ctrl->average_gpu_time <= 0) {
+            ctrl->average_gpu_time = gpu_time;
+        }
+        else {
+            ctrl->average_gpu_time = lerp_f64(ctrl->average_gpu_time, RESOLUTION_GPU_TIME_SMOOTHING, gpu_time);
+        }
+
+        // NOTE(justas): cost goes with the number of pixels, so with the square of the scale.
+        auto budget = (1.0 / r->target_fps) * RESOLUTION_GPU_BUDGET;
+        auto wanted = (f32)(ctrl->scale * sqrt_f64(budget / MAX(ctrl->average_gpu_time, 0.000001)));
+        clamp(&wanted, r->min_resolution_scale, r->max_resolution_scale);
+
+        // NOTE(justas): drop as soon as we're over, but only go back up once there's
+        // clearly room for it so we don't flip between two scales.
+        if(wanted < ctrl->scale - RESOLUTION_SCALE_STEP * .5f || wanted > ctrl->scale + RESOLUTION_SCALE_STEP * 2) {
+            auto stepped = floor_f32(wanted / RESOLUTION_SCALE_STEP) * RESOLUTION_SCALE_STEP;
+            clamp(&stepped, r->min_resolution_scale, r->max_resolution_scale);
+
+            if(stepped != ctrl->scale) {
+                ctrl->scale = stepped;
+
+                // NOTE(justas): measurements of the old scale don't say much about the new one.
+                ctrl->average_gpu_time = 0;
+            }
+        }
+    }
+
+    clamp(&ctrl->scale, r->min_resolution_scale, r->max_resolution_scale);
+
+    render_size = make_vector(
+        MAX(floor_f32(window_size.x * ctrl->scale), 1.f),
+        MAX(floor_f32(window_size.y * ctrl->scale), 1.f)
+    );
+}
+
+intern
+void resolution_controller_begin_frame(Resolution_Controller * ctrl) {
+    if(!ctrl->is_active) {
+        return;
+    }
+
+    default_framebuffer = ctrl->fbo;
+    gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, ctrl->fbo);
+    gl_state_viewport(0, 0, render_size.x, render_size.y);
+
+    gpu_timer_begin(&ctrl->timer);
+}
+
+intern
+void resolution_controller_end_frame(Resolution_Controller * ctrl) {
+    if(!ctrl->is_active) {
+        return;
+    }
+
+    default_framebuffer = 0;
+
+    gl_state_bind_framebuffer(GL_READ_FRAMEBUFFER, ctrl->fbo);
+    gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(
+        0, 0, render_size.x, render_size.y,
+        0, 0, window_size.x, window_size.y,
+        GL_COLOR_BUFFER_BIT, GL_LINEAR
+    );
+    gl_state_bind_framebuffer(GL_FRAMEBUFFER, 0);
+    gl_state_viewport(0, 0, window_size.x, window_size.y);
+
+    gpu_timer_end(&ctrl->timer);
+}
+
+// NOTE(justas): paces frames against absolute deadlines. usleep wakes up late by however long the
+// scheduler feels like, so we sleep until we're spin_margin away from the deadline and spin the
+// rest. The margin follows the oversleep we've actually seen.
+#define NUM_FRAME_PACER_HISTORY 256
+#define FRAME_PACER_MIN_SPIN_MARGIN 0.0005
+#define FRAME_PACER_MAX_SPIN_MARGIN 0.004
+
+struct Frame_Pacer {
+    timespec epoch;
+
+    f64 next_deadline;
+    f64 last_frame_start;
+    f64 spin_margin;
+    s64 num_missed_deadlines;
+
+    // NOTE(justas): seconds between frame starts, oldest first after history_head.
+    f64 history[NUM_FRAME_PACER_HISTORY];
+    s64 history_head;
+    s64 num_history;
+};
+
+struct Frame_Pacer_Stats {
+    f64 average;
+    f64 min;
+    f64 max;
+    f64 jitter;
+};
+
+intern force_inline
+f64 frame_pacer_now(Frame_Pacer * pacer) {
+    return plat_get_time_delta_in_seconds(plat_get_high_frequency_time(), pacer->epoch);
+}
+
+intern
+void frame_pacer_start(Frame_Pacer * pacer) {
+    *pacer = {};
+    pacer->epoch = plat_get_high_frequency_time();
+    pacer->spin_margin = .002;
+}
+
+intern
+void frame_pacer_sleep_until(Frame_Pacer * pacer, f64 deadline) {
+    auto now = frame_pacer_now(pacer);
+    auto sleep_until = deadline - pacer->spin_margin;
+
+    if(sleep_until > now) {
+        plat_sleep(sleep_until - now);
+
+        auto oversleep = frame_pacer_now(pacer) - sleep_until;
+
+        // NOTE(justas): jump up right away when we wake up late, come back down slowly.
+        pacer->spin_margin = MAX(pacer->spin_margin * .99, oversleep * 1.25);
+        clamp(&pacer->spin_margin, FRAME_PACER_MIN_SPIN_MARGIN, FRAME_PACER_MAX_SPIN_MARGIN);
+    }
+
+    while(frame_pacer_now(pacer) < deadline) {
+        // NOTE(justas): spin
+    }
+}
+
+// NOTE(justas): call at the end of every frame. Sleeps until the next frame is due when
+// should_wait is set, otherwise vsync or nothing paces us. Returns the time since the previous
+// frame started, which is the dt the next frame should see.
+intern
+f64 frame_pacer_end_frame(Frame_Pacer * pacer, f64 target_delta, b32 should_wait) {
+    auto now = frame_pacer_now(pacer);
+
+    if(should_wait && target_delta > 0) {
+        pacer->next_deadline += target_delta;
+
+        if(now > pacer->next_deadline) {
+            // NOTE(justas): don't try to make up for a long frame with a burst of short ones.
+            pacer->num_missed_deadlines++;
+            pacer->next_deadline = now;
+        }
+        else {
+            frame_pacer_sleep_until(pacer, pacer->next_deadline);
+        }
+    }
+    else {
+        pacer->next_deadline = now;
+    }
+
+    auto frame_start = frame_pacer_now(pacer);
+    auto delta = frame_start - pacer->last_frame_start;
+    pacer->last_frame_start = frame_start;
+
+    pacer->history[pacer->history_head] = delta;
+    pacer->history_head = (pacer->history_head + 1) % NUM_FRAME_PACER_HISTORY;
+    pacer->num_history = MIN(pacer->num_history + 1, (s64)NUM_FRAME_PACER_HISTORY);
+
+    return delta;
+}
+
+intern
+Frame_Pacer_Stats get_frame_pacer_stats(Frame_Pacer * pacer) {
+    Frame_Pacer_Stats ret = {};
+    if(pacer->num_history == 0) {
+        return ret;
+    }
+
+    ret.min = F64_POSITIVE_MAXIMUM;
+    ret.max = F64_NEGATIVE_MAXIMUM;
+
+    f64 sum = 0;
+    ForRange(index, 0, pacer->num_history) {
+        auto delta = pacer->history[index];
+        sum += delta;
+        ret.min = MIN(ret.min, delta);
+        ret.max = MAX(ret.max, delta);
+    }
+    ret.average = sum / pacer->num_history;
+
+    f64 variance = 0;
+    ForRange(index, 0, pacer->num_history) {
+        auto diff = pacer->history[index] - ret.average;
+        variance += diff * diff;
+    }
+    ret.jitter = sqrt_f64(variance / pacer->num_history);
+
+    return ret;
+}
+
+intern
+void draw_frame_pacer_window(Frame_Pacer * pacer, f64 target_delta) {
+    if(ImGui::Begin("Frame pacing")) {
+        auto stats = get_frame_pacer_stats(pacer);
+
+        ImGui::Text("target: %.3fms", target_delta * 1000.0);
+        ImGui::Text("average: %.3fms, min %.3fms, max %.3fms", stats.average * 1000.0, stats.min * 1000.0, stats.max * 1000.0);
+        ImGui::Text("jitter: %.3fms", stats.jitter * 1000.0);
+        ImGui::Text("missed deadlines: %lld", pacer->num_missed_deadlines);
+        ImGui::Text("spin margin: %.3fms", pacer->spin_margin * 1000.0);
+
+        f32 history_ms[NUM_FRAME_PACER_HISTORY];
+        ForRange(index, 0, pacer->num_history) {
+            auto at = (pacer->history_head - pacer->num_history + index + NUM_FRAME_PACER_HISTORY) % NUM_FRAME_PACER_HISTORY;
+            history_ms[index] = (f32)(pacer->history[at] * 1000.0);
+        }
+
+        ImGui::PlotLines("##frame times", history_ms, (s32)pacer->num_history, 0, "frame ms", 0, (f32)(target_delta * 2000.0), ImVec2(0, 60));
+    }
+    ImGui::End();
+}
+
+struct Headless_Context {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+
+    u32 fbo;
+    u32 color_rbo;
+};
+
+intern
+b32 egl_has_extension(const char * extensions, const char * name) {
+    if(!extensions) {
+        return false;
+    }
+
+    auto list = make_string(extensions);
+    auto wanted = make_string(name);
+
+    s64 start = 0;
+    ForRange(index, 0, list.length + 1) {
+        if(index != list.length && list.str[index] != ' ') {
+            continue;
+        }
+
+        if(string_equals_case_sensitive(make_string(list.str + start, index - start), wanted)) {
+            return true;
+        }
+
+        start = index + 1;
+    }
+
+    return false;
+}
+
+intern
+GL3WglProc egl_get_proc(const char * proc) {
+    return (GL3WglProc)eglGetProcAddress(proc);
+}
+
+// NOTE(justas): no window system here. On mesa this goes through EGL_MESA_platform_surfaceless
+// so llvmpipe works without an X server. Everything gets rendered into an fbo which then acts as
+// the "default" framebuffer for the lua scripts.
+intern
+b32 try_create_headless_context(
+        v2 size,
+        Headless_Context * out_ctx,
+        String * out_error
+) {
+    Headless_Context ctx = {};
+
+    auto client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    if(egl_has_extension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+        auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if(get_platform_display) {
+            ctx.display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+        }
+    }
+
+    if(ctx.display == EGL_NO_DISPLAY) {
+        ctx.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    if(ctx.display == EGL_NO_DISPLAY) {
+        *out_error = "failed to get an EGL display"_S;
+        return false;
+    }
+
+    if(!eglInitialize(ctx.display, 0, 0)) {
+        *out_error = "eglInitialize failed"_S;
+        return false;
+    }
+
+    if(!eglBindAPI(EGL_OPENGL_API)) {
+        *out_error = "eglBindAPI(EGL_OPENGL_API) failed"_S;
+        return false;
+    }
+
+    auto display_extensions = eglQueryString(ctx.display, EGL_EXTENSIONS);
+    auto can_go_surfaceless = egl_has_extension(display_extensions, "EGL_KHR_surfaceless_context");
+
+    EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, can_go_surfaceless ? EGL_DONT_CARE : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if(!eglChooseConfig(ctx.display, config_attribs, &config, 1, &num_configs) || num_configs == 0) {
+        *out_error = "no suitable EGL config"_S;
+        return false;
+    }
+
+    EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    ctx.context = eglCreateContext(ctx.display, config, EGL_NO_CONTEXT, context_attribs);
+    if(ctx.context == EGL_NO_CONTEXT) {
+        *out_error = "failed to create a 3.3 core EGL context"_S;
+        return false;
+    }
+
+    if(!can_go_surfaceless) {
+        // NOTE(justas): we never draw to this, it's just here so we can make the context current.
+        EGLint pbuffer_attribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+
+        ctx.surface = eglCreatePbufferSurface(ctx.display, config, pbuffer_attribs);
+        if(ctx.surface == EGL_NO_SURFACE) {
+            *out_error = "failed to create a pbuffer surface"_S;
+            return false;
+        }
+    }
+
+    if(!eglMakeCurrent(ctx.display, ctx.surface, ctx.surface, ctx.context)) {
+        *out_error = "eglMakeCurrent failed"_S;
+        return false;
+    }
+
+    if(gl3wInit2(egl_get_proc) != GL3W_OK) {
+        *out_error = "gl3w failed to load GL procs through EGL"_S;
+        return false;
+    }
+
+    glGenRenderbuffers(1, &ctx.color_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, ctx.color_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, size.x, size.y);
+
+    glGenFramebuffers(1, &ctx.fbo);
+    gl_state_bind_framebuffer(GL_FRAMEBUFFER, ctx.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ctx.color_rbo);
+
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        *out_error = "headless framebuffer is incomplete"_S;
+        return false;
+    }
+
+    *out_ctx = ctx;
+    return true;
+}
+
+intern
+void free_headless_context(Headless_Context * ctx) {
+    gl_state_forget_framebuffer(ctx->fbo);
+    glDeleteFramebuffers(1, &ctx->fbo);
+    glDeleteRenderbuffers(1, &ctx->color_rbo);
+
+    eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if(ctx->surface != EGL_NO_SURFACE) {
+        eglDestroySurface(ctx->display, ctx->surface);
+    }
+
+    eglDestroyContext(ctx->display, ctx->context);
+    eglTerminate(ctx->display);
+}
+
+struct Launch_Options {
+    const char * script_file_dir = 0;
+
+    b32 is_headless = false;
+    v2 headless_size = {};
+    s64 num_headless_frames = 0;
+
+    const char * dump_dir = 0;
+    const char * dump_pipe_command = 0;
+
+    // NOTE(justas): when > 0 every frame advances time by exactly 1/fixed_fps and we never sleep.
+    f64 fixed_fps = 0;
+
+    // NOTE(justas): 0 means the default under the user's cache dir.
+    const char * shader_cache_dir = 0;
+    b32 is_shader_cache_disabled = false;
+
+    // NOTE(justas): records every profiler zone of the run and writes a chrome trace at exit.
+    const char * trace_file = 0;
+};
+
+intern
+b32 try_parse_size(const char * cstr, v2 * out_size) {
+    auto parts = string_split(make_string(cstr), 'x', &temp_allocator);
+    if(parts.watermark != 2) {
+        return false;
+    }
+
+    s64 w, h;
+    if(!string_parse_s64(parts.storage[0], &w, &temp_allocator)) return false;
+    if(!string_parse_s64(parts.storage[1], &h, &temp_allocator)) return false;
+    if(w <= 0 || h <= 0) return false;
+
+    *out_size = make_vector((f32)w, (f32)h);
+    return true;
+}
+
+intern
+b32 try_parse_launch_options(s32 argc, char ** argv, Launch_Options * out_opts) {
+    Launch_Options opts = {};
+
+    for(s32 index = 1; index < argc; index++) {
+        auto arg = make_string(argv[index]);
+        auto has_value = index + 1 < argc;
+
+        if(string_equals_case_sensitive(arg, "--headless"_S)) {
+            if(!has_value || !try_parse_size(argv[++index], &opts.headless_size)) {
+                printf("--headless expects a size like 1920x1080\n");
+                return false;
+            }
+            opts.is_headless = true;
+        }
+        else if(string_equals_case_sensitive(arg, "--frames"_S)) {
+            if(!has_value || !string_parse_s64(make_string(argv[++index]), &opts.num_headless_frames, &temp_allocator)) {
+                printf("--frames expects a number\n");
+                return false;
+            }
+        }
+        else if(string_equals_case_sensitive(arg, "--fixed-fps"_S)) {
+            char * end = 0;
+            if(has_value) {
+                opts.fixed_fps = strtod(argv[++index], &end);
+            }
+
+            if(!end || *end != '\0' || opts.fixed_fps <= 0) {
+                printf("--fixed-fps expects a positive number\n");
+                return false;
+            }
+        }
+        else if(string_equals_case_sensitive(arg, "--dump"_S)) {
+            if(!has_value) {
+                printf("--dump expects a file path or '-' for stdout\n");
+                return false;
+            }
+            opts.dump_dir = argv[++index];
+        }
+        else if(string_equals_case_sensitive(arg, "--dump-pipe"_S)) {
+            if(!has_value) {
+                printf("--dump-pipe expects a command to pipe y4m frames into\n");
+                return false;
+            }
+            opts.dump_pipe_command = argv[++index];
+        }
+        else if(string_equals_case_sensitive(arg, "--shader-cache"_S)) {
+            if(!has_value) {
+                printf("--shader-cache expects a directory\n");
+                return false;
+            }
+            opts.shader_cache_dir = argv[++index];
+        }
+        else if(string_equals_case_sensitive(arg, "--no-shader-cache"_S)) {
+            opts.is_shader_cache_disabled = true;
+        }
+        else if(string_equals_case_sensitive(arg, "--trace"_S)) {
+            if(!has_value) {
+                printf("--trace expects a file to write the chrome trace json into\n");
+                return false;
+            }
+            opts.trace_file = argv[++index];
+        }
+        else if(!opts.script_file_dir) {
+            opts.script_file_dir = argv[index];
+        }
+        else {
+            printf("unknown argument '%s'\n", argv[index]);
+            return false;
+        }
+    }
+
+    if(!opts.script_file_dir) {
+        return false;
+    }
+
+    if(opts.is_headless && opts.num_headless_frames <= 0) {
+        printf("--headless needs --frames N with N > 0\n");
+        return false;
+    }
+
+    if(opts.dump_dir && opts.dump_pipe_command) {
+        printf("--dump and --dump-pipe can't be used at the same time\n");
+        return false;
+    }
+
+    if(!opts.is_headless && opts.num_headless_frames > 0) {
+        printf("--frames only works together with --headless\n");
+        return false;
+    }
+
+    if(opts.shader_cache_dir && opts.is_shader_cache_disabled) {
+        printf("--shader-cache and --no-shader-cache can't be used at the same time\n");
+        return false;
+    }
+
+    *out_opts = opts;
+    return true;
+}
+
+intern
+const char * get_default_shader_cache_dir() {
+    auto * cache_home = getenv("XDG_CACHE_HOME");
+    String base;
+
+    if(cache_home && cache_home[0]) {
+        base = make_string(cache_home);
+    }
+    else {
+        auto * home = getenv("HOME");
+        if(!home || !home[0]) {
+            return 0;
+        }
+
+        base = format_temp_string(&temp_allocator, "%s/.cache", home);
+        plat_create_directory(base.str);
+    }
+
+    return format_string(&main_thread_allocator, base.length + 32, "%.*s/shader-livecode", (s32)base.length, base.str).string.str;
+}
+
+enum FRAME_WRITER_FORMAT_ {
+    // NOTE(justas): RGBA8, bottom row first, back to back. No header, the consumer is expected
+    // to know the size it asked for.
+    FRAME_WRITER_FORMAT_RAW,
+
+    // NOTE(justas): one binary ppm per frame, the path has a printf style %d (with an optional
+    // 0 and width) that gets the frame index. We expand it ourselves, the path is never a format.
+    FRAME_WRITER_FORMAT_PPM_SEQUENCE,
+
+    // NOTE(justas): a single yuv4mpeg2 stream, 4:4:4, BT.601 limited range. Both ffmpeg and mpv read it.
+    FRAME_WRITER_FORMAT_Y4M,
+};
+
+#define MAX_FRAME_PATH_LENGTH 512
+
+// NOTE(justas): a ppm path split around its frame number, with %% already turned into %.
+struct Frame_Path_Pattern {
+    char prefix[MAX_FRAME_PATH_LENGTH];
+    char suffix[MAX_FRAME_PATH_LENGTH];
+    s32 width;
+    b32 is_zero_padded;
+};
+
+intern
+b32 try_parse_frame_path_pattern(const char * pattern, Frame_Path_Pattern * out) {
+    *out = {};
+
+    auto * dst = out->prefix;
+    s64 length = 0;
+    s64 num_conversions = 0;
+
+    for(s64 index = 0; pattern[index]; index++) {
+        auto c = pattern[index];
+
+        if(c == '%' && pattern[index + 1] != '%') {
+            if(num_conversions > 0) {
+                return false;
+            }
+
+            index++;
+            if(pattern[index] == '0') {
+                out->is_zero_padded = true;
+                index++;
+            }
+
+            while(pattern[index] >= '0' && pattern[index] <= '9') {
+                out->width = out->width * 10 + (pattern[index] - '0');
+                if(out->width > 32) {
+                    return false;
+                }
+                index++;
+            }
+
+            if(pattern[index] != 'd' && pattern[index] != 'i' && pattern[index] != 'u') {
+                return false;
+            }
+
+            num_conversions++;
+            dst[length] = 0;
+            dst = out->suffix;
+            length = 0;
+            continue;
+        }
+
+        if(c == '%') {
+            index++;
+        }
+
+        if(length + 1 >= MAX_FRAME_PATH_LENGTH) {
+            return false;
+        }
+        dst[length++] = c;
+    }
+
+    dst[length] = 0;
+    return num_conversions == 1;
+}
+
+struct Frame_Writer {
+    FRAME_WRITER_FORMAT_ format;
+    s32 width;
+    s32 height;
+    f64 fps;
+
+    FILE * out;
+    b32 is_pipe;
+    Frame_Path_Pattern path_pattern;
+
+    // NOTE(justas): only touched by the writer thread, holds the converted frame.
+    Memory_Allocation scratch;
+    b32 has_failed;
+};
+
+intern
+b32 try_open_frame_writer(
+        Frame_Writer * writer,
+        const char * dir,
+        const char * pipe_command,
+        v2 size,
+        f64 fps
+) {
+    *writer = {};
+    writer->width = (s32)size.x;
+    writer->height = (s32)size.y;
+    writer->fps = fps;
+
+    if(pipe_command) {
+        // NOTE(justas): the encoder going away shouldn't take us down with it, we notice the
+        // failed write instead.
+        signal(SIGPIPE, SIG_IGN);
+
+        writer->format = FRAME_WRITER_FORMAT_Y4M;
+        writer->is_pipe = true;
+        writer->out = popen(pipe_command, "w");
+    }
+    else {
+        auto path = make_string(dir);
+
+        if(string_equals_case_sensitive(path, "-"_S)) {
+            // NOTE(justas): frames go to the real stdout, everything we printf goes to stderr
+            // from here on so the two don't get mixed up.
+            auto frames_fd = dup(STDOUT_FILENO);
+            fflush(stdout);
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+
+            writer->format = FRAME_WRITER_FORMAT_RAW;
+            writer->out = fdopen(frames_fd, "wb");
+        }
+        else if(string_ends_with(path, ".y4m"_S)) {
+            writer->format = FRAME_WRITER_FORMAT_Y4M;
+            writer->out = fopen(dir, "wb");
+        }
+        else if(string_ends_with(path, ".ppm"_S)) {
+            if(!try_parse_frame_path_pattern(dir, &writer->path_pattern)) {
+                printf("ppm dumps need exactly one frame number in the path, like frames/%%05d.ppm (use %%%% for a literal %%)\n");
+                return false;
+            }
+
+            writer->format = FRAME_WRITER_FORMAT_PPM_SEQUENCE;
+            writer->scratch = plat_mem_allocate((s64)writer->width * (s64)writer->height * 3);
+            return true;
+        }
+        else {
+            writer->format = FRAME_WRITER_FORMAT_RAW;
+            writer->out = fopen(dir, "wb");
+        }
+    }
+
+    if(!writer->out) {
+        return false;
+    }
+
+    if(writer->format == FRAME_WRITER_FORMAT_Y4M) {
+        writer->scratch = plat_mem_allocate((s64)writer->width * (s64)writer->height * 3);
+
+        fprintf(writer->out, "YUV4MPEG2 W%d H%d F%lld:1000 Ip A1:1 C444\n",
+            writer->width, writer->height, (s64)round(fps * 1000.0)
+        );
+    }
+
+    return true;
+}
+
+intern
+void close_frame_writer(Frame_Writer * writer) {
+    if(writer->out) {
+        if(writer->is_pipe) {
+            pclose(writer->out);
+        }
+        else {
+            fclose(writer->out);
+        }
+    }
+
+    if(writer->scratch.data) {
+        plat_mem_free(writer->scratch);
+    }
+}
+
+// NOTE(justas): runs on the writer thread.
+intern
+void frame_writer_write(Frame_Writer * writer, u8 * rgba, s64 frame_index) {
+    if(writer->has_failed) {
+        return;
+    }
+
+    auto w = (s64)writer->width;
+    auto h = (s64)writer->height;
+
+    switch(writer->format) {
+        case FRAME_WRITER_FORMAT_RAW: {
+            if(fwrite(rgba, 1, w * h * 4, writer->out) != (size_t)(w * h * 4)) {
+                writer->has_failed = true;
+            }
+            break;
+        }
+        case FRAME_WRITER_FORMAT_PPM_SEQUENCE: {
+            auto * rgb = (u8*)writer->scratch.data;
+
+            // NOTE(justas): gl gives us the bottom row first, ppm wants the top one first.
+            ForRange(y, 0, h) {
+                auto * src = rgba + (h - 1 - y) * w * 4;
+                auto * dst = rgb + y * w * 3;
+
+                ForRange(x, 0, w) {
+                    dst[x * 3 + 0] = src[x * 4 + 0];
+                    dst[x * 3 + 1] = src[x * 4 + 1];
+                    dst[x * 3 + 2] = src[x * 4 + 2];
+                }
+            }
+
+            auto * pattern = &writer->path_pattern;
+
+            char path[MAX_FRAME_PATH_LENGTH * 2 + 64];
+            snprintf(path, sizeof(path), pattern->is_zero_padded ? "%s%0*lld%s" : "%s%*lld%s",
+                pattern->prefix, pattern->width, frame_index, pattern->suffix
+            );
+
+            auto * f = fopen(path, "wb");
+            if(!f) {
+                writer->has_failed = true;
+                break;
+            }
+
+            fprintf(f, "P6\n%lld %lld\n255\n", w, h);
+            if(fwrite(rgb, 1, w * h * 3, f) != (size_t)(w * h * 3)) {
+                writer->has_failed = true;
+            }
+            fclose(f);
+            break;
+        }
+        case FRAME_WRITER_FORMAT_Y4M: {
+            auto * y_plane = (u8*)writer->scratch.data;
+            auto * u_plane = y_plane + w * h;
+            auto * v_plane = u_plane + w * h;
+
+            ForRange(y, 0, h) {
+                auto * src = rgba + (h - 1 - y) * w * 4;
+                auto row = y * w;
+
+                ForRange(x, 0, w) {
+                    s32 r = src[x * 4 + 0];
+                    s32 g = src[x * 4 + 1];
+                    s32 b = src[x * 4 + 2];
+
+                    y_plane[row + x] = (u8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+                    u_plane[row + x] = (u8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                    v_plane[row + x] = (u8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+                }
+            }
+
+            fputs("FRAME\n", writer->out);
+            if(fwrite(y_plane, 1, w * h * 3, writer->out) != (size_t)(w * h * 3)) {
+                writer->has_failed = true;
+            }
+            break;
+        }
+    }
+}
+
+// NOTE(justas): glReadPixels straight into client memory stalls until the gpu has finished the
+// frame. Instead we read into a ring of pixel buffer objects and only map a slot once it comes
+// around again NUM_READBACK_SLOTS frames later, by which point its fence has long been signaled.
+// Mapped frames are copied into one of NUM_CAPTURE_BUFFERS buffers and handed to a writer thread,
+// which hands the buffer back once it's on disk.
+#define NUM_READBACK_SLOTS 3
+#define NUM_CAPTURE_BUFFERS 8
+
+struct Captured_Frame {
+    Memory_Allocation pixels;
+    s64 frame_index;
+};
+
+struct Readback_Slot {
+    u32 pbo;
+    GLsync fence;
+    s64 frame_index;
+};
+
+struct Frame_Capture {
+    s32 width;
+    s32 height;
+    s64 frame_size;
+
+    // NOTE(justas): when false we wait on the gpu and on the writer instead of dropping frames.
+    b32 can_drop_frames;
+    s64 num_dropped_frames;
+    s64 num_written_frames;
+
+    Readback_Slot slots[NUM_READBACK_SLOTS];
+    s64 next_slot;
+
+    Memory_Allocation buffers[NUM_CAPTURE_BUFFERS];
+    Spsc_Queue<Captured_Frame> to_writer;
+    Spsc_Queue<Memory_Allocation> free_buffers;
+
+    // NOTE(justas): the writer is the only one pushing into free_buffers once it runs, so a
+    // buffer the main thread takes and doesn't use waits here for the next collect.
+    Memory_Allocation spare_buffer;
+    b32 has_spare_buffer;
+
+    Frame_Writer writer;
+    b32 should_stop;
+    Plat_Thread writer_thread;
+};
+
+intern
+void frame_capture_writer_proc(void * data) {
+    auto * cap = (Frame_Capture*)data;
+
+    while(true) {
+        auto is_stopping = atomic_fetch(&cap->should_stop);
 
-            if(shader->id != -1) {
-                glDeleteProgram(shader->id);
-                shader->id = -1;
+        Captured_Frame frame;
+        if(spsc_queue_pop(&cap->to_writer, &frame)) {
+            frame_writer_write(&cap->writer, (u8*)frame.pixels.data, frame.frame_index);
+            if(!cap->writer.has_failed) {
+                atomic_store(&cap->num_written_frames, cap->num_written_frames + 1);
             }
 
-            for(auto & kvp : t) {
-                auto part_hash = (u64)kvp.second.as<void*>();
-                auto * part = table_insert_or_initialize_new(&r->shader_parts, part_hash);
-                *array_append(&shader->part_hashes) = part->comparison_hash;
+            auto did_push = spsc_queue_push(&cap->free_buffers, frame.pixels);
+            assert(did_push);
+            continue;
+        }
 
-                if(part->id == -1) {
-                    printf("gl_load_shader was passed an uninitialized shader %llu!\n", part_hash);
+        if(is_stopping) {
+            break;
+        }
 
-                    auto a = make_string_copy(part->error, &malloc_allocator);
-                    shader->error = a.string;
+        plat_sleep(0.001);
+    }
 
-                    glDeleteProgram(shader->id);
-                    return (void*)hash;
-                }
+    if(cap->writer.out) {
+        fflush(cap->writer.out);
+    }
+}
 
-                glAttachShader(id, part->id);
-            }
-            glLinkProgram(id);
+intern
+b32 try_start_frame_capture(
+        Frame_Capture * cap,
+        Frame_Writer writer,
+        v2 size,
+        b32 can_drop_frames
+) {
+    *cap = {};
+    cap->width = (s32)size.x;
+    cap->height = (s32)size.y;
+    cap->frame_size = (s64)cap->width * (s64)cap->height * 4;
+    cap->can_drop_frames = can_drop_frames;
+    cap->writer = writer;
+
+    cap->to_writer = make_spsc_queue<Captured_Frame>(16, &malloc_allocator);
+    cap->free_buffers = make_spsc_queue<Memory_Allocation>(16, &malloc_allocator);
+
+    ForRange(index, 0, NUM_CAPTURE_BUFFERS) {
+        cap->buffers[index] = plat_mem_allocate(cap->frame_size);
+        spsc_queue_push(&cap->free_buffers, cap->buffers[index]);
+    }
+
+    ForRange(index, 0, NUM_READBACK_SLOTS) {
+        auto * slot = cap->slots + index;
+        glGenBuffers(1, &slot->pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, cap->frame_size, 0, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return plat_thread_start(&cap->writer_thread, frame_capture_writer_proc, cap);
+}
+
+intern
+void frame_capture_collect_slot(Frame_Capture * cap, Readback_Slot * slot, b32 can_drop) {
+    if(!slot->fence) {
+        return;
+    }
 
-            String error;
-            if(!did_shader_compile_properly(id, &temp_allocator, &error)) {
-                printf("Failed to compile shader '%s'. Error:\n", cname);
-                printf("%.*s\n", error.length, error.str);
+    auto wait_status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, can_drop ? 0 : GL_TIMEOUT_IGNORED);
+    glDeleteSync(slot->fence);
+    slot->fence = 0;
 
-                auto a = make_string_copy(error, &malloc_allocator);
-                shader->error = a.string;
+    if(wait_status == GL_TIMEOUT_EXPIRED || wait_status == GL_WAIT_FAILED) {
+        cap->num_dropped_frames++;
+        return;
+    }
 
-                glDeleteProgram(id);
-                return (void*)hash;
+    Memory_Allocation buffer;
+    if(cap->has_spare_buffer) {
+        buffer = cap->spare_buffer;
+        cap->has_spare_buffer = false;
+    }
+    else {
+        while(!spsc_queue_pop(&cap->free_buffers, &buffer)) {
+            if(can_drop) {
+                cap->num_dropped_frames++;
+                return;
             }
+            plat_sleep(0.0005);
+        }
+    }
 
-            shader->id = id;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    auto * pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, cap->frame_size, GL_MAP_READ_BIT);
 
+    if(pixels) {
+        copy_bytes((u8*)buffer.data, (u8*)pixels, cap->frame_size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
 
-            {
-                s32 num_uniforms;
-                s32 max_name_length;
-                glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &num_uniforms);
-                glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+        Captured_Frame frame;
+        frame.pixels = buffer;
+        frame.frame_index = slot->frame_index;
 
-                array_reserve(&shader->uniforms, num_uniforms);
+        auto did_push = spsc_queue_push(&cap->to_writer, frame);
+        assert(did_push);
+    }
+    else {
+        cap->num_dropped_frames++;
+        cap->spare_buffer = buffer;
+        cap->has_spare_buffer = true;
+    }
 
-                ForRange(index, 0, num_uniforms) {
-                    auto * uniform = array_append(&shader->uniforms);
-                    auto name_alloc = m_new(&malloc_allocator, max_name_length);
-                    uniform->id = index;
-                    uniform->name = make_string((const char*)name_alloc.data);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
 
-                    s32 temp;
-                    glGetActiveUniform(id, index, max_name_length, &temp, &temp, &uniform->type, (GLchar*)uniform->name.str);
-                }
-            }
-        }
-        return (void*)hash;
-    };
+intern
+void frame_capture_submit(
+        Frame_Capture * cap,
+        u32 read_framebuffer,
+        GLenum read_buffer,
+        v2 size,
+        s64 frame_index
+) {
+    if((s32)size.x != cap->width || (s32)size.y != cap->height) {
+        cap->num_dropped_frames++;
+        return;
+    }
 
-    lua["gl_enable_alpha_blend"] = [](Lua_Renderer * r) {
-        glEnable(GL_BLEND);
-        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
-    };
-    lua["gl_disable_alpha_blend"] = [](Lua_Renderer * r) {
-        glDisable(GL_BLEND);
-    };
+    auto * slot = cap->slots + cap->next_slot;
+    cap->next_slot = (cap->next_slot + 1) % NUM_READBACK_SLOTS;
 
-    lua["gl_clear_color"] = [](Lua_Renderer * r) {
-        glClear(GL_COLOR_BUFFER_BIT);
-    };
+    frame_capture_collect_slot(cap, slot, cap->can_drop_frames);
 
-    lua["gl_default_viewport"] = [](Lua_Renderer * r) {
-        glViewport(0,0,window_size.x, window_size.y);
-    };
+    gl_state_bind_framebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+    glReadBuffer(read_buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    glReadPixels(0, 0, cap->width, cap->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-    lua["gl_default_fb"] = [](Lua_Renderer * r ) {
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    };
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->frame_index = frame_index;
+}
 
-    lua["gl_draw_quad"] = [](Lua_Renderer * r) {
-        glBindVertexArray(quad_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, quad_vbo);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    };
+intern
+void frame_capture_finish(Frame_Capture * cap) {
+    // NOTE(justas): oldest slot first so frames reach the writer in order.
+    ForRange(index, 0, NUM_READBACK_SLOTS) {
+        auto * slot = cap->slots + ((cap->next_slot + index) % NUM_READBACK_SLOTS);
+        frame_capture_collect_slot(cap, slot, false);
+    }
 
-    lua["gl_uniform_f32"] = [](Lua_Renderer * r, const char * uniform, f32 num) {
-        set_uniform_f32(&r->active_shader, uniform, num);
-    };
+    atomic_store(&cap->should_stop, true);
+    plat_thread_join(&cap->writer_thread);
 
-    lua["gl_uniform_v2_f32"] = [](Lua_Renderer * r, const char * uniform, f32 x, f32 y) {
-        v2 v = {x,y};
-        set_uniform_v2_f32(&r->active_shader, uniform, v);
-    };
+    ForRange(index, 0, NUM_READBACK_SLOTS) {
+        glDeleteBuffers(1, &cap->slots[index].pbo);
+    }
 
-    lua["gl_enable_srgb"] = [](Lua_Renderer * r) {
-        glEnable(GL_FRAMEBUFFER_SRGB);
-    };
+    ForRange(index, 0, NUM_CAPTURE_BUFFERS) {
+        plat_mem_free(cap->buffers[index]);
+    }
 
-    lua["gl_disable_srgb"] = [](Lua_Renderer * r) {
-        glDisable(GL_FRAMEBUFFER_SRGB);
-    };
+    spsc_queue_free(&cap->to_writer);
+    spsc_queue_free(&cap->free_buffers);
 
+    if(cap->writer.has_failed) {
+        printf("capture: the frame writer failed, output is incomplete\n");
+    }
+    close_frame_writer(&cap->writer);
 
-    return true;
+    printf("capture: wrote %lld frames, dropped %lld\n", cap->num_written_frames, cap->num_dropped_frames);
 }
 
 int main(int argc, char** argv) {
-    if(argc != 2) {
-        printf("usage: %s <loop lua file> \n", argv[0]);
+    Launch_Options opts;
+    if(!try_parse_launch_options(argc, argv, &opts)) {
+        printf("usage: %s <loop lua file> [--fixed-fps N] [--dump file|-|frames/%%05d.ppm|out.y4m] [--dump-pipe command] [--headless WxH --frames N] [--shader-cache dir | --no-shader-cache] [--trace file.json]\n", argv[0]);
         return 1;
     }
+    memory_allocator_arena_reset(&temp_allocator);
 
-    window_size = make_vector(1280, 720);
-    SDL_Init(SDL_INIT_EVENTS | SDL_INIT_VIDEO);
-
-    auto window = SDL_CreateWindow("shader-env", 
-            SDL_WINDOWPOS_UNDEFINED, 
-            SDL_WINDOWPOS_UNDEFINED,
-            window_size.x, window_size.y,
-            SDL_WINDOW_OPENGL | SDL_WINDOW_BORDERLESS);
+    SDL_Window * window = 0;
+    Headless_Context headless = {};
 
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
-    SDL_GL_SetAttribute(SDL_GL_FRAMEBUFFER_SRGB_CAPABLE, 1);
+    if(opts.is_headless) {
+        window_size = opts.headless_size;
 
-    auto gl_context = SDL_GL_CreateContext(window);
-
-    gl3wInit();
-    
-    glClearColor(0,0,0,1);
+        String error;
+        if(!try_create_headless_context(window_size, &headless, &error)) {
+            printf("failed to create headless context: %.*s\n", error.length, error.str);
+            return 1;
+        }
 
-    SDL_GL_SetSwapInterval(1);
+        default_framebuffer = headless.fbo;
+        gl_state_viewport(0,0,window_size.x, window_size.y);
 
-    // Setup Dear ImGui context
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
-    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
+        printf("running headless at %dx%d: %s\n", (s32)window_size.x, (s32)window_size.y, glGetString(GL_RENDERER));
+    }
+    else {
+        window_size = make_vector(1280, 720);
+        SDL_Init(SDL_INIT_EVENTS | SDL_INIT_VIDEO);
+
+        window = SDL_CreateWindow("shader-env",
+                SDL_WINDOWPOS_UNDEFINED,
+                SDL_WINDOWPOS_UNDEFINED,
+                window_size.x, window_size.y,
+                SDL_WINDOW_OPENGL | SDL_WINDOW_BORDERLESS);
+
+        SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+        SDL_GL_SetAttribute(SDL_GL_FRAMEBUFFER_SRGB_CAPABLE, 1);
+
+        auto gl_context = SDL_GL_CreateContext(window);
+
+        gl3wInit();
+
+        SDL_GL_SetSwapInterval(1);
+
+        // Setup Dear ImGui context
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO(); (void)io;
+        //io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
+        //io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
+
+        // Setup Dear ImGui style
+        ImGui::StyleColorsDark();
+        //ImGui::StyleColorsClassic();
+
+        // Setup Platform/Renderer bindings
+        ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
+        ImGui_ImplOpenGL3_Init(0);
+    }
 
-    // Setup Dear ImGui style
-    ImGui::StyleColorsDark();
-    //ImGui::StyleColorsClassic();
+    glClearColor(0,0,0,1);
 
-    // Setup Platform/Renderer bindings
-    ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
-    ImGui_ImplOpenGL3_Init(0);
+    // NOTE(justas): whatever the context creation left bound, we don't assume anything about it.
+    gl_state_invalidate();
 
     glGenVertexArrays(1, &quad_vao);
-    glBindVertexArray(quad_vao);
+    gl_state_bind_vertex_array(quad_vao);
 
     glGenBuffers(1, &quad_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, quad_vbo);
+    gl_state_bind_array_buffer(quad_vbo);
 
     f32 quadVerts[] = {
         -1.0f, -1.0f,
@@ -851,25 +4696,107 @@ int main(int argc, char** argv) {
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVerts), quadVerts, GL_STATIC_DRAW);
 
+    should_compile_shaders_synchronously = opts.is_headless || opts.fixed_fps > 0;
+    init_parallel_shader_compile(opts.is_headless ? egl_get_proc : gl3wGetProcAddress);
+
+    if(!opts.is_shader_cache_disabled) {
+        auto * dir = opts.shader_cache_dir;
+        if(!dir) {
+            dir = get_default_shader_cache_dir();
+        }
+
+        init_program_binary_cache(dir);
+    }
+
+    render_size = window_size;
+
+    // NOTE(justas): offline renders have no frame budget and need the same output every run.
+    auto can_scale_resolution = !opts.is_headless && opts.fixed_fps <= 0;
+
+    Resolution_Controller resolution = {};
+    if(can_scale_resolution) {
+        resolution_controller_start(&resolution);
+    }
+
+    glGenBuffers(1, &frame_uniform_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frame_uniform_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Frame_Uniform_Block), 0, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BLOCK_BINDING, frame_uniform_buffer);
+
+    // NOTE(justas): F3 writes here too, or to a default file when there's no --trace.
+    auto * trace_file = opts.trace_file ? opts.trace_file : "livecode_trace.json";
+
+    if(opts.trace_file) {
+        profiler_start_tracing(&profiler);
+    }
+
     b32 should_quit = false;
 
     dt = 1.0f/60.f;
+    if(opts.fixed_fps > 0) {
+        dt = 1.0 / opts.fixed_fps;
+    }
 
-    auto script_file_dir = argv[1];
+    auto script_file_dir = opts.script_file_dir;
+
+    // NOTE(justas): nobody edits shaders mid offline render.
+    are_assets_frozen = opts.is_headless;
+    if(!opts.is_headless) {
+        try_start_file_watcher(&file_watcher);
+    }
 
     Asset_Entry script_asset = {};
     script_asset.path = script_file_dir;
 
     sol::state lua_state; 
 
-    while(!should_quit) {
-        auto startT = std::chrono::high_resolution_clock::now();
+    Frame_Capture capture = {};
+    b32 is_capturing = false;
+    if(opts.dump_dir || opts.dump_pipe_command) {
+        // NOTE(justas): without a fixed timestep we don't know the real rate so y4m just says 60.
+        auto fps = opts.fixed_fps > 0 ? opts.fixed_fps : 60.0;
+
+        Frame_Writer writer;
+        if(!try_open_frame_writer(&writer, opts.dump_dir, opts.dump_pipe_command, window_size, fps)) {
+            printf("failed to open '%s' for dumping frames\n", opts.dump_pipe_command ? opts.dump_pipe_command : opts.dump_dir);
+            return 1;
+        }
+
+        // NOTE(justas): live captures drop frames instead of ever making the render thread wait.
+        // Offline renders have no deadline to miss so they wait for the writer and stay complete.
+        if(!try_start_frame_capture(&capture, writer, window_size, !opts.is_headless)) {
+            printf("failed to start the frame capture writer thread\n");
+            return 1;
+        }
+        is_capturing = true;
+    }
+
+    s64 frame_index = 0;
+    auto run_start = std::chrono::high_resolution_clock::now();
+
+    Frame_Pacer pacer;
+    frame_pacer_start(&pacer);
 
+    // NOTE(justas): vsync paces us when the script wants the display's rate. Anything else
+    // needs it off, or swaps would block on the display and fight the pacer.
+    b32 is_vsync_on = !opts.is_headless;
+
+    while(!should_quit) {
         memory_allocator_arena_reset(&temp_allocator);
-        shader_time += dt;
+
+        profiler_begin_frame(&profiler, frame_index);
+
+        if(opts.fixed_fps > 0) {
+            // NOTE(justas): derived from the frame index instead of accumulated so that frame N
+            // always gets the exact same time no matter how long the run was.
+            shader_time = (f32)(frame_index * dt);
+        }
+        else {
+            shader_time += dt;
+        }
 
         SDL_Event event;
-        while(SDL_PollEvent(&event)) {
+        while(!opts.is_headless && SDL_PollEvent(&event)) {
             ImGui_ImplSDL2_ProcessEvent(&event);
 
             if(event.type == SDL_QUIT) {
@@ -895,6 +4822,39 @@ int main(int argc, char** argv) {
                         show_uniform_window = !show_uniform_window;
                         break;
                     }
+                    case SDLK_F2: {
+                        show_profiler_window = !show_profiler_window;
+
+                        if(show_profiler_window) {
+                            profiler_start(&profiler);
+                        }
+                        else if(!profiler.is_tracing) {
+                            profiler_stop(&profiler);
+                        }
+                        break;
+                    }
+                    case SDLK_F3: {
+                        if(!profiler.is_tracing) {
+                            profiler_start_tracing(&profiler);
+                            printf("[profiler] tracing...\n");
+                            break;
+                        }
+
+                        profiler_flush(&profiler);
+                        if(profiler_write_chrome_trace(&profiler, trace_file)) {
+                            printf("[profiler] wrote %lld zones to %s\n", profiler.trace_events.watermark, trace_file);
+                        }
+                        else {
+                            printf("[profiler] failed to write %s\n", trace_file);
+                        }
+
+                        profiler_stop_tracing(&profiler);
+
+                        if(!show_profiler_window) {
+                            profiler_stop(&profiler);
+                        }
+                        break;
+                    }
                 }
             }
             else if(event.type == SDL_WINDOWEVENT)
@@ -904,43 +4864,105 @@ int main(int argc, char** argv) {
 
                     window_size.x = event.window.data1;
                     window_size.y = event.window.data2;
-                    glViewport(0,0,window_size.x, window_size.y);
+                    gl_state_viewport(0,0,window_size.x, window_size.y);
+                }
+            }
+        }
+
+        if(file_watcher.is_running) {
+            File_Change change;
+            while(spsc_queue_pop(&file_watcher.changes, &change)) {
+                mark_asset_if_changed(&script_asset, change);
+
+                For(renderer.asset_catalogue) {
+                    mark_asset_if_changed(&it->value, change);
+                }
+            }
+
+            // NOTE(justas): the content hash check keeps this from reloading what didn't change.
+            if(atomic_swap(&file_watcher.needs_rescan, 0)) {
+                printf("[file watcher] lost track of some changes, rechecking every watched asset\n");
+
+                mark_asset_for_rescan(&script_asset);
+                For(renderer.asset_catalogue) {
+                    mark_asset_for_rescan(&it->value);
                 }
             }
         }
 
         if(does_asset_need_loading(&script_asset)) {
+            auto zone = profiler_begin_cpu("script reload"_S);
+            defer { profiler_end(zone); };
+
+            auto script_read = plat_fs_read_entire_file(script_asset.path, &temp_allocator);
+
+            if(!script_read.did_succeed) {
+                script_asset.has_content_hash = false;
+                printf("[renderer] load error: failed to read lua script\n");
 
-            String error;
-            Lua_Renderer temp;
-            if(!try_load_renderer(script_asset.path, &temp, &error)) {
-                printf("[renderer] load error: %.*s\n", error.length, error.str);
+                if(opts.is_headless && !renderer.needs_free) {
+                    return 1;
+                }
+            }
+            else if(!did_asset_content_change(&script_asset, script_read.as_string)) {
+                printf("[renderer] script is unchanged, not reloading\n");
             }
             else {
-                printf("reloaded renderer\n");
-                if(renderer.needs_free) {
-                    renderer.free();
+                String error;
+                Lua_Renderer temp;
+                if(!try_load_renderer(script_read.as_string, &temp, &error)) {
+                    printf("[renderer] load error: %.*s\n", error.length, error.str);
+
+                    if(opts.is_headless && !renderer.needs_free) {
+                        return 1;
+                    }
+                }
+                else {
+                    printf("reloaded renderer\n");
+                    if(renderer.needs_free) {
+                        renderer.free();
+                    }
+                    renderer = std::move(temp);
+
+                    // NOTE(justas): the renderer only has a stable address once it's in here.
+                    renderer.lua["r"] = &renderer;
                 }
-                renderer = std::move(temp);
             }
         }
 
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplSDL2_NewFrame(window);
-        ImGui::NewFrame();
-    
+        if(!opts.is_headless) {
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplSDL2_NewFrame(window);
+            ImGui::NewFrame();
+        }
+
         if(renderer.can_render) {
-            auto & lua = renderer.lua;
-
-            lua["dt"] = dt;
-            lua["r"] = &renderer;
-            lua["_time"] = shader_time;
-            lua["_resolution_x"] = (f32)window_size.x;
-            lua["_resolution_y"] = (f32)window_size.y;
-            
+            if(can_scale_resolution) {
+                resolution_controller_update(&resolution, &renderer);
+                resolution_controller_begin_frame(&resolution);
+            }
+
+            update_frame_uniform_buffer();
+
+            auto * frame = renderer.frame;
+            frame->dt = dt;
+            frame->time = shader_time;
+            frame->resolution_x = render_size.x;
+            frame->resolution_y = render_size.y;
+            frame->index = frame_index;
+
+            renderer.batch.num_commands = 0;
+            renderer.batch.num_dropped_commands = 0;
+            renderer.batch.num_requested_program_switches = 0;
+            renderer.batch.num_program_switches = 0;
+
             {
-                sol::protected_function render_fx = lua["render"];
-                auto result = render_fx();
+                auto zone = profiler_begin_cpu("lua render()"_S);
+                defer { profiler_end(zone); };
+
+                TRACE_ZONE("lua render()");
+
+                auto result = renderer.render_fn();
 
                 if(!result.valid()) {
                     sol::error e = result;
@@ -948,105 +4970,353 @@ int main(int argc, char** argv) {
                     renderer.can_render = false;
                 }
             }
+
+            // NOTE(justas): for scripts that never submit their batch or call gl_run_passes.
+            submit_render_batch(&renderer);
+
+            {
+                auto zone = profiler_begin_cpu("render graph"_S);
+                run_render_graph(&renderer);
+                profiler_end(zone);
+            }
+
+            resolution_controller_end_frame(&resolution);
         }
 
-        {
-            struct Err {
-                String source;
-                String error;
-            };
+        if(is_capturing) {
+            // NOTE(justas): before imgui so the ui doesn't end up in the capture.
+            if(opts.is_headless) {
+                frame_capture_submit(&capture, headless.fbo, GL_COLOR_ATTACHMENT0, window_size, frame_index);
+            }
+            else {
+                frame_capture_submit(&capture, 0, GL_BACK, window_size, frame_index);
+            }
+        }
+
+        if(opts.is_headless) {
+            if(frame_index + 1 >= opts.num_headless_frames) {
+                should_quit = true;
+            }
+        }
+        else {
+            auto imgui_zone = profiler_begin_cpu("imgui"_S);
+
+            {
+                struct Err {
+                    String source;
+                    String error;
+                };
 
-            auto errors = make_array<Err>(0, renderer.temp_alloc, "errors"_S);
+                auto errors = make_array<Err>(0, renderer.temp_alloc, "errors"_S);
 
-            for(auto * kvp : renderer.shaders) {
-                auto * shader = &kvp->value;
+                for(auto * kvp : renderer.shaders) {
+                    auto * shader = &kvp->value;
 
-                if(shader->error.length > 0) {
-                    auto * err = array_append(&errors);
-                    err->error = shader->error;
-                    err->source = shader->name;
+                    if(shader->error.length > 0) {
+                        auto * err = array_append(&errors);
+                        err->error = shader->error;
+                        err->source = shader->name;
+                    }
                 }
-            }
 
-            if(errors.watermark > 0) {
-                if(ImGui::Begin("Errors")) {
-                    for(auto * err : errors) {
-                        ImGui::Text("====%.*s====", err->source.length, err->source.str);
-                        ImGui::Text("%.*s", err->error.length, err->error.str);
+                if(errors.watermark > 0) {
+                    if(ImGui::Begin("Errors")) {
+                        for(auto * err : errors) {
+                            ImGui::Text("====%.*s====", err->source.length, err->source.str);
+                            ImGui::Text("%.*s", err->error.length, err->error.str);
+                        }
                     }
+                    ImGui::End();
+                }
+            }
+
+            if(renderer.render_targets.watermark > 0) {
+                if(ImGui::Begin("Passes")) {
+                    ImGui::Text("drawn: %lld", renderer.num_drawn_passes);
+                    ImGui::Text("cached: %lld", renderer.num_cached_passes);
                 }
                 ImGui::End();
             }
-        }
 
-        {
-            auto uniforms = make_array<Uniform_Info*>(0, renderer.temp_alloc, "uniforms"_S);
-            for(auto * kvp : renderer.shaders) {
-                auto * shader = &kvp->value;
+            if(renderer.batch.num_commands > 0) {
+                if(ImGui::Begin("Batch")) {
+                    ImGui::Text("commands: %lld", renderer.batch.num_commands);
+                    ImGui::Text("dropped: %lld", renderer.batch.num_dropped_commands);
+                    ImGui::Text("program switches: %lld (script asked for %lld)", renderer.batch.num_program_switches, renderer.batch.num_requested_program_switches);
+                }
+                ImGui::End();
+            }
+
+            if(show_profiler_window) {
+                profiler_draw_panel(&profiler);
+            }
 
-                if(shader->uniforms.watermark > 0) {
-                    fetch_shader_uniform_values(shader);
+            if(show_profiler_window) {
+                draw_frame_pacer_window(&pacer, 1.0 / renderer.target_fps);
 
-                    for(auto * uniform : shader->uniforms) {
-                        *array_append(&uniforms) = uniform;
+                if(ImGui::Begin("GL state")) {
+                    ImGui::Text("calls made / skipped last frame");
+                    ForRange(index, 0, GL_STATE_COUNT) {
+                        ImGui::Text("%s: %lld / %lld", gl_state_names[index], gl_state.last_frame_issued[index], gl_state.last_frame_skipped[index]);
                     }
                 }
+                ImGui::End();
+            }
+
+            if(resolution.is_active) {
+                if(ImGui::Begin("Resolution")) {
+                    ImGui::Text("scale: %.2f (%dx%d)", resolution.scale, (s32)render_size.x, (s32)render_size.y);
+                    ImGui::Text("gpu: %.2fms", resolution.average_gpu_time * 1000.0);
+                }
+                ImGui::End();
             }
 
-            if(uniforms.watermark > 0 && show_uniform_window) {
-                if(ImGui::Begin("Uniforms")) {
+            if(is_capturing) {
+                if(ImGui::Begin("Capture")) {
+                    ImGui::Text("written: %lld", atomic_fetch(&capture.num_written_frames));
+                    ImGui::Text("dropped: %lld", capture.num_dropped_frames);
 
+                    if(capture.writer.has_failed) {
+                        ImGui::Text("the frame writer failed, output is incomplete!");
+                    }
+                }
+                ImGui::End();
+            }
 
-                    for(auto ** uniform_ptr : uniforms) {
-                        auto * it = *uniform_ptr;
+            {
+                auto uniforms = make_array<Uniform_Info*>(0, renderer.temp_alloc, "uniforms"_S);
+                for(auto * kvp : renderer.shaders) {
+                    auto * shader = &kvp->value;
 
-                        if(it->type == GL_FLOAT) {
-                            ImGui::DragFloat(it->name.str, &it->as.float32);
-                        }
-                        else if(it->type == GL_FLOAT_VEC2) {
-                            ImGui::DragFloat2(it->name.str, &it->as.float32);
+                    if(shader->uniforms.watermark > 0) {
+                        for(auto * uniform : shader->uniforms) {
+                            *array_append(&uniforms) = uniform;
                         }
-                        else if(it->type == GL_FLOAT_VEC3) {
-                            ImGui::DragFloat3(it->name.str, &it->as.float32);
-                        }
-                        else if(it->type == GL_FLOAT_VEC4) {
-                            ImGui::DragFloat4(it->name.str, &it->as.float32);
-                        }
-                        else if(it->type == GL_INT) {
-                            ImGui::DragInt(it->name.str, &it->as.signed32);
-                        }
-                        else if(it->type == GL_BOOL) {
-                            ImGui::Checkbox(it->name.str, &it->as.boolean);
+                    }
+                }
+
+                if(uniforms.watermark > 0 && show_uniform_window) {
+                    if(ImGui::Begin("Uniforms")) {
+
+
+                        for(auto ** uniform_ptr : uniforms) {
+                            auto * it = *uniform_ptr;
+
+                            if(it->type == GL_FLOAT) {
+                                if(ImGui::DragFloat(it->name.str, &it->as.float32)) {
+                                    it->is_dirty = true;
+                                }
+                            }
+                            else if(it->type == GL_FLOAT_VEC2) {
+                                if(ImGui::DragFloat2(it->name.str, &it->as.float32)) {
+                                    it->is_dirty = true;
+                                }
+                            }
+                            else if(it->type == GL_FLOAT_VEC3) {
+                                if(ImGui::DragFloat3(it->name.str, &it->as.float32)) {
+                                    it->is_dirty = true;
+                                }
+                            }
+                            else if(it->type == GL_FLOAT_VEC4) {
+                                if(ImGui::DragFloat4(it->name.str, &it->as.float32)) {
+                                    it->is_dirty = true;
+                                }
+                            }
+                            else if(it->type == GL_INT) {
+                                if(ImGui::DragInt(it->name.str, &it->as.signed32)) {
+                                    it->is_dirty = true;
+                                }
+                            }
+                            else if(it->type == GL_BOOL) {
+                                if(ImGui::Checkbox(it->name.str, &it->as.boolean)) {
+                                    it->is_dirty = true;
+                                }
+                            }
                         }
                     }
+                    ImGui::End();
                 }
-                ImGui::End();
-            }
 
-            for(auto * kvp : renderer.shaders) {
-                auto * shader = &kvp->value;
+                for(auto * kvp : renderer.shaders) {
+                    auto * shader = &kvp->value;
 
-                if(shader->uniforms.watermark > 0) {
-                    flush_shader_uniform_values(shader);
+                    if(shader->uniforms.watermark > 0) {
+                        flush_shader_uniform_values(shader);
+                    }
                 }
             }
-        }
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        SDL_GL_SwapWindow(window);
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+            profiler_end(imgui_zone);
+
+            auto swap_zone = profiler_begin_cpu("swap"_S);
+            SDL_GL_SwapWindow(window);
+            profiler_end(swap_zone);
+        }
+
+        gl_state_end_frame();
 
-        auto delta = std::chrono::duration<f64>(std::chrono::high_resolution_clock::now() - startT).count();
         auto target_delta = 1.0 / renderer.target_fps;
 
-        if(target_delta > delta) {
-            auto wait_time = target_delta - delta;
-            plat_sleep(wait_time);
-            dt = target_delta;
+        frame_index++;
+
+        if(!opts.is_headless) {
+            SDL_DisplayMode mode;
+            auto refresh_rate = 0;
+            if(SDL_GetWindowDisplayMode(window, &mode) == 0) {
+                refresh_rate = mode.refresh_rate;
+            }
+
+            b32 wants_vsync = refresh_rate > 0 && fabs(renderer.target_fps - refresh_rate) < 1.0;
+            if(wants_vsync != is_vsync_on) {
+                SDL_GL_SetSwapInterval(wants_vsync ? 1 : 0);
+                is_vsync_on = wants_vsync;
+            }
         }
-        else {
+
+        // NOTE(justas): offline runs go as fast as they can, with fixed_fps dt stays at 1/fixed_fps.
+        auto should_wait = !opts.is_headless && opts.fixed_fps <= 0 && !is_vsync_on;
+        auto delta = frame_pacer_end_frame(&pacer, target_delta, should_wait);
+
+        if(opts.fixed_fps <= 0) {
             dt = delta;
         }
     }
+
+    if(is_capturing) {
+        frame_capture_finish(&capture);
+    }
+
+    stop_file_watcher(&file_watcher);
+
+    if(can_scale_resolution) {
+        resolution_controller_stop(&resolution);
+    }
+
+    if(profiler.is_tracing) {
+        profiler_flush(&profiler);
+
+        if(profiler_write_chrome_trace(&profiler, trace_file)) {
+            printf("[profiler] wrote %lld zones to %s\n", profiler.trace_events.watermark, trace_file);
+        }
+        else {
+            printf("[profiler] failed to write %s\n", trace_file);
+        }
+    }
+
+    profiler_stop(&profiler);
+
+    if(opts.is_headless) {
+        glFinish();
+
+        auto total = std::chrono::duration<f64>(std::chrono::high_resolution_clock::now() - run_start).count();
+        printf("rendered %lld frames in %.3fs (%.2f fps, %.3fms/frame)\n",
+            frame_index, total, frame_index / total, (total / frame_index) * 1000.0
+        );
+
+        free_headless_context(&headless);
+    }
+
+    return 0;
+}
+
+#if defined (TESTING)
+
+TEST(frame_path_pattern) {
+    Frame_Path_Pattern pattern;
+
+    assert(try_parse_frame_path_pattern("frames/%05d.ppm", &pattern));
+    assert(string_equals(make_string(pattern.prefix), "frames/"_S));
+    assert(string_equals(make_string(pattern.suffix), ".ppm"_S));
+    assert(pattern.width == 5);
+    assert(pattern.is_zero_padded);
+
+    assert(try_parse_frame_path_pattern("100%%/f%d.ppm", &pattern));
+    assert(string_equals(make_string(pattern.prefix), "100%/f"_S));
+    assert(pattern.width == 0);
+    assert(!pattern.is_zero_padded);
+
+    // NOTE(justas): anything that isn't exactly one integer conversion gets turned down.
+    assert(!try_parse_frame_path_pattern("frames/out.ppm", &pattern));
+    assert(!try_parse_frame_path_pattern("frames/%s.ppm", &pattern));
+    assert(!try_parse_frame_path_pattern("frames/%d_%d.ppm", &pattern));
+    assert(!try_parse_frame_path_pattern("frames/%n.ppm", &pattern));
+    assert(!try_parse_frame_path_pattern("frames/%5", &pattern));
+    assert(!try_parse_frame_path_pattern("frames/%999999d.ppm", &pattern));
+}
+
+TEST(render_pass_key_follows_uniform_values) {
+    Gl_Shader shader;
+    shader.id = 1;
+
+    auto * channel = array_append(&shader.uniforms);
+    *channel = {};
+    auto * resolution = array_append(&shader.uniforms);
+    *resolution = {};
+
+    Render_Pass pass = {};
+    pass.shader_hash = 7;
+
+    Render_Texture output = {};
+    output.generation = 3;
+
+    // NOTE(justas): two passes sharing the program, each setting its own values every frame.
+    channel->as.signed32 = 0;
+    resolution->as.vector2_f32 = make_vector(256.0f, 256.0f);
+    auto first_key = get_render_pass_key(0, &pass, &shader, &output);
+
+    channel->as.signed32 = 1;
+    resolution->as.vector2_f32 = make_vector(128.0f, 128.0f);
+    auto second_key = get_render_pass_key(0, &pass, &shader, &output);
+    assert(first_key != second_key);
+
+    // NOTE(justas): the next frame the first pass sets the same values again and stays cached.
+    channel->as.signed32 = 0;
+    resolution->as.vector2_f32 = make_vector(256.0f, 256.0f);
+    assert(get_render_pass_key(0, &pass, &shader, &output) == first_key);
+
+    shader.untracked_uniform_version++;
+    assert(get_render_pass_key(0, &pass, &shader, &output) != first_key);
+
+    shader.free();
+}
+
+TEST(render_batch_keeps_draw_order) {
+    auto shaders = make_table<Gl_Shader>(8, &global_test_allocator, "test shaders"_S);
+    table_insert(&shaders, 1)->id = 10;
+    table_insert(&shaders, 2)->id = 20;
+
+    Render_Batch batch = {};
+    batch.commands = make_array<Render_Command>(8, &global_test_temp_allocator, "test batch"_S);
+
+    // NOTE(justas): both draws cover the whole default fb, the last one drawn is what's visible.
+    batch.shader_hash = 2;
+    record_render_command(&batch, RENDER_COMMAND_DEFAULT_FB);
+    record_render_command(&batch, RENDER_COMMAND_DRAW_QUAD);
+
+    batch.shader_hash = 1;
+    record_render_command(&batch, RENDER_COMMAND_DRAW_QUAD);
+    record_render_command(&batch, RENDER_COMMAND_DRAW_QUAD);
+
+    resolve_render_batch(&batch, &shaders, 0);
+
+    assert(batch.commands.watermark == 4);
+    assert(batch.commands.storage[0].type == RENDER_COMMAND_DEFAULT_FB);
+    assert(batch.commands.storage[1].shader_hash == 2);
+    assert(batch.commands.storage[2].shader_hash == 1);
+    assert(batch.commands.storage[3].shader_hash == 1);
+
+    // NOTE(justas): the last draw reuses the program the one before it bound.
+    assert(batch.commands.storage[1].flags == RENDER_COMMAND_SWITCH_PROGRAM);
+    assert(batch.commands.storage[2].flags == RENDER_COMMAND_SWITCH_PROGRAM);
+    assert(batch.commands.storage[3].flags == 0);
+    assert(batch.num_program_switches == 2);
+    assert(batch.num_dropped_commands == 0);
+
+    table_free(&shaders);
 }
+
+#endif
@@ -202,8 +202,21 @@ struct Memory_Allocation {
     s64 length;
 };
 
+// NOTE(justas): what malloc and friends already give us, asking for less is free.
+#define MALLOC_ALIGNMENT 16
+#define CACHE_LINE_SIZE 64
+
+intern force_inline
+u64 align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
 intern Memory_Allocation plat_mem_allocate(s64 num_bytes);
 intern void plat_mem_free(Memory_Allocation mem);
+intern Memory_Allocation plat_mem_reallocate(Memory_Allocation mem, s64 num_bytes);
+intern Memory_Allocation plat_mem_reserve(s64 num_bytes);
+intern void plat_mem_commit(void * data, s64 num_bytes);
+intern void plat_mem_decommit(void * data, s64 num_bytes);
 
 
 intern
@@ -296,6 +309,43 @@ public:
  
 #define defer const auto & MACRO_CONCAT(defer__, __LINE__) = DeferExitScopeHelp() + [&]()
 
+// NOTE(justas): TRACE_ZONE("name") at the top of a block records how long the block took while
+// tracing is on. Developer builds have it, otherwise define STORMY_TRACE. The name has to
+// outlive the trace, so string literals only.
+#if defined(DEVELOPER) && !defined(STORMY_TRACE)
+    #define STORMY_TRACE
+#endif
+
+#if defined(STORMY_TRACE)
+    intern b32 trace_is_recording();
+    intern f64 trace_now();
+    intern void trace_record_zone(const char * name, f64 start, f64 end);
+
+    struct Trace_Scope {
+        const char * name;
+        f64 start;
+
+        Trace_Scope(const char * zone_name) {
+            name = 0;
+
+            if(trace_is_recording()) {
+                name = zone_name;
+                start = trace_now();
+            }
+        }
+
+        ~Trace_Scope() {
+            if(name) {
+                trace_record_zone(name, start, trace_now());
+            }
+        }
+    };
+
+    #define TRACE_ZONE(name) Trace_Scope MACRO_CONCAT(trace_zone__, __LINE__)(name)
+#else
+    #define TRACE_ZONE(name)
+#endif
+
 // NOTE(justas): underscore is required for clang
 intern force_inline constexpr
 String operator "" _S(const char * cstring, std::size_t length) {
@@ -459,6 +509,18 @@ b32 string_starts_with(
     return string_index_of(target, starts_with) == 0;
 }
 
+intern force_inline
+b32 string_ends_with(
+        String target, 
+        String ends_with
+) {
+    if(ends_with.length > target.length) {
+        return false;
+    }
+
+    return string_equals_case_sensitive(make_string(target.str + target.length - ends_with.length, ends_with.length), ends_with);
+}
+
 
 intern force_inline
 s64 string_last_index_of(
@@ -542,6 +604,11 @@ void set_bytes(u8 *destination, u8 pattern, s64 num_bytes) {
     memset((void*)destination, (int)pattern, (size_t)num_bytes);
 }
 
+intern
+b32 are_bytes_equal(const u8 *a, const u8 *b, s64 num_bytes) {
+    return memcmp(a, b, (size_t)num_bytes) == 0;
+}
+
 struct Allocate_String_Result {
     Memory_Allocation mem;
     String string;
@@ -588,6 +655,44 @@ struct Directory_Entry {
         assert(status);
     }
 
+    // NOTE(justas): no mremap here, so this one always moves.
+    intern
+    Memory_Allocation plat_mem_reallocate(Memory_Allocation mem, s64 num_bytes) {
+        auto ret = plat_mem_allocate(num_bytes);
+        copy_bytes((u8*)ret.data, (u8*)mem.data, MIN(mem.length, num_bytes));
+        plat_mem_free(mem);
+
+        return ret;
+    }
+
+    // NOTE(justas): address space only, touching it faults until it's committed.
+    // plat_mem_free releases it.
+    intern
+    Memory_Allocation plat_mem_reserve(s64 num_bytes) {
+        assert(num_bytes > 0, "plat_mem_reserve reservation was less than or equal to 0 bytes");
+
+        auto ptr = VirtualAlloc(0, num_bytes, MEM_RESERVE, PAGE_NOACCESS);
+        assert(ptr);
+
+        Memory_Allocation ret;
+        ret.data = ptr;
+        ret.length = num_bytes;
+
+        return ret;
+    }
+
+    intern
+    void plat_mem_commit(void * data, s64 num_bytes) {
+        auto ptr = VirtualAlloc(data, num_bytes, MEM_COMMIT, PAGE_READWRITE);
+        assert(ptr);
+    }
+
+    intern
+    void plat_mem_decommit(void * data, s64 num_bytes) {
+        b32 status = VirtualFree(data, num_bytes, MEM_DECOMMIT);
+        assert(status);
+    }
+
 #elif defined(IS_LINUX)
     baked String PLAT_SEPARATOR = "/"_S;
 
@@ -633,6 +738,12 @@ struct Directory_Entry {
     T atomic_swap(T * data, T new_value) {
         return __atomic_exchange_n(data, new_value, __ATOMIC_SEQ_CST);
     }
+
+    template<typename T>
+    intern force_inline
+    T atomic_fetch_add(T * data, T value) {
+        return __atomic_fetch_add(data, value, __ATOMIC_SEQ_CST);
+    }
     
     intern
     Memory_Allocation plat_mem_allocate(s64 num_bytes) {
@@ -670,15 +781,79 @@ struct Directory_Entry {
             assert(false);
         }
     }
+
+    // NOTE(justas): the kernel moves the page tables around instead of us copying the bytes,
+    // and it grows in place when the address space after it is free.
+    intern
+    Memory_Allocation plat_mem_reallocate(Memory_Allocation mem, s64 num_bytes) {
+        void * data = mremap(mem.data, (size_t)mem.length, (size_t)num_bytes, MREMAP_MAYMOVE);
+
+        if(data == MAP_FAILED) {
+            printf("plat_mem_reallocate: failed to mremap %lld bytes to %lld (errno is: %d).\n", mem.length, num_bytes, errno);
+            assert(false);
+        }
+
+        Memory_Allocation ret;
+
+        ret.data = data;
+        ret.length = num_bytes;
+
+        return ret;
+    }
+
+    // NOTE(justas): address space only, touching it faults until it's committed.
+    // plat_mem_free releases it.
+    intern
+    Memory_Allocation plat_mem_reserve(s64 num_bytes) {
+        assert(num_bytes > 0, "plat_mem_reserve reservation was less than or equal to 0 bytes");
+
+        void * data = mmap(0, (size_t)num_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if(data == MAP_FAILED) {
+            printf("plat_mem_reserve: failed to reserve %lld bytes (errno is: %d).\n", num_bytes, errno);
+            assert(false);
+        }
+
+        Memory_Allocation mem;
+
+        mem.data = data;
+        mem.length = num_bytes;
+
+        return mem;
+    }
+
+    intern
+    void plat_mem_commit(void * data, s64 num_bytes) {
+        s32 status = mprotect(data, (size_t)num_bytes, PROT_READ | PROT_WRITE);
+
+        if(status == -1) {
+            printf("plat_mem_commit: failed to commit %lld bytes at %p. Errno is %d\n", num_bytes, data, errno);
+            assert(false);
+        }
+    }
+
+    // NOTE(justas): hands the pages back to the kernel but keeps the address space reserved.
+    intern
+    void plat_mem_decommit(void * data, s64 num_bytes) {
+        madvise(data, (size_t)num_bytes, MADV_DONTNEED);
+        s32 status = mprotect(data, (size_t)num_bytes, PROT_NONE);
+
+        if(status == -1) {
+            printf("plat_mem_decommit: failed to decommit %lld bytes at %p. Errno is %d\n", num_bytes, data, errno);
+            assert(false);
+        }
+    }
 #endif
 
 baked Memory_Allocation null_page = {0,0};
 
 struct Memory_Allocator;
+intern Memory_Allocation memory_allocator_allocate_aligned(Memory_Allocator * generic_allocator, s64 num_bytes, s64 alignment, const char * reason);
 intern Memory_Allocation memory_allocator_allocate(Memory_Allocator * generic_allocator, s64 num_bytes, const char * reason);
 
 intern void memory_allocator_free(Memory_Allocator * generic_allocator, Memory_Allocation allocation);
 
+intern Memory_Allocation memory_allocator_reallocate_aligned(Memory_Allocator * void_allocator, Memory_Allocation allocation, s64 new_size, s64 alignment, const char* reason);
 intern Memory_Allocation memory_allocator_reallocate(Memory_Allocator * void_allocator, Memory_Allocation allocation, s64 new_size, const char* reason);
 
 struct Read_File_Result {
@@ -763,6 +938,12 @@ const char * temp_cstring(
         return __atomic_exchange_n(data, new_value, __ATOMIC_SEQ_CST);
     }
 
+    template<typename T>
+    intern force_inline
+    T atomic_fetch_add(T * data, T value) {
+        return __atomic_fetch_add(data, value, __ATOMIC_SEQ_CST);
+    }
+
 
     intern
     void plat_sleep(f64 seconds) {
@@ -788,6 +969,8 @@ const char * temp_cstring(
 
     intern
     Read_File_Result plat_fs_read_entire_file(const char * dir, Memory_Allocator * persistent_allocator) {
+        TRACE_ZONE("plat_fs_read_entire_file");
+
         Read_File_Result ret;
         ret.did_succeed = false;
         
@@ -848,6 +1031,16 @@ const char * temp_cstring(
         return ((time.dwHighDateTime << 16) << 16) | time.dwLowDateTime;
     }
 
+    // NOTE(justas): succeeds if the directory already exists
+    intern
+    b32 plat_create_directory(const char * dir) {
+        if(CreateDirectoryA(dir, 0)) {
+            return true;
+        }
+
+        return GetLastError() == ERROR_ALREADY_EXISTS;
+    }
+
 #elif defined(IS_LINUX) 
     intern
     void plat_sleep(f64 seconds) {
@@ -872,6 +1065,8 @@ const char * temp_cstring(
 
     intern
     Read_File_Result plat_fs_read_entire_file(const char * dir, Memory_Allocator * persistent_allocator) {
+        TRACE_ZONE("plat_fs_read_entire_file");
+
         Read_File_Result ret = {};
 
         FILE * f = fopen(dir, "r");
@@ -916,6 +1111,16 @@ const char * temp_cstring(
         return attribs.st_mtim.tv_sec;
     }
 
+    // NOTE(justas): succeeds if the directory already exists
+    intern
+    b32 plat_create_directory(const char * dir) {
+        if(mkdir(dir, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) == 0) {
+            return true;
+        }
+
+        return errno == EEXIST;
+    }
+
 #endif
 
 struct AtomicSpinlock {
@@ -3297,6 +3502,107 @@ u64 hash_fnv(String str, u64 hash = 14695981039346656037UL)
     return hash;
 }
 
+// NOTE(justas): xxhash64. Eats 32 bytes per round in four independent lanes,
+// so it's a lot faster than fnv on anything bigger than a name. Use it for file contents.
+baked u64 XX64_PRIME_1 = 11400714785074694791UL;
+baked u64 XX64_PRIME_2 = 14029467366897019727UL;
+baked u64 XX64_PRIME_3 = 1609587929392839161UL;
+baked u64 XX64_PRIME_4 = 9650029242287828579UL;
+baked u64 XX64_PRIME_5 = 2870177450012600261UL;
+
+intern force_inline
+u64 xx64_rotate_left(u64 value, s32 amount) {
+    return (value << amount) | (value >> (64 - amount));
+}
+
+intern force_inline
+u64 xx64_read_u64(const u8 * at) {
+    u64 ret;
+    copy_bytes((u8*)&ret, at, sizeof(ret));
+    return ret;
+}
+
+intern force_inline
+u32 xx64_read_u32(const u8 * at) {
+    u32 ret;
+    copy_bytes((u8*)&ret, at, sizeof(ret));
+    return ret;
+}
+
+intern force_inline
+u64 xx64_round(u64 accumulator, u64 input) {
+    accumulator += input * XX64_PRIME_2;
+    accumulator = xx64_rotate_left(accumulator, 31);
+    return accumulator * XX64_PRIME_1;
+}
+
+intern force_inline
+u64 xx64_merge_round(u64 hash, u64 lane) {
+    hash ^= xx64_round(0, lane);
+    return hash * XX64_PRIME_1 + XX64_PRIME_4;
+}
+
+intern
+u64 hash_xx64(String str, u64 seed = 0) {
+    auto * at = (const u8*)str.str;
+    auto * end = at + str.length;
+
+    u64 hash;
+
+    if(str.length >= 32) {
+        u64 lane1 = seed + XX64_PRIME_1 + XX64_PRIME_2;
+        u64 lane2 = seed + XX64_PRIME_2;
+        u64 lane3 = seed;
+        u64 lane4 = seed - XX64_PRIME_1;
+
+        auto * last_stripe = end - 32;
+        while(at <= last_stripe) {
+            lane1 = xx64_round(lane1, xx64_read_u64(at));
+            lane2 = xx64_round(lane2, xx64_read_u64(at + 8));
+            lane3 = xx64_round(lane3, xx64_read_u64(at + 16));
+            lane4 = xx64_round(lane4, xx64_read_u64(at + 24));
+            at += 32;
+        }
+
+        hash = xx64_rotate_left(lane1, 1) + xx64_rotate_left(lane2, 7) + xx64_rotate_left(lane3, 12) + xx64_rotate_left(lane4, 18);
+        hash = xx64_merge_round(hash, lane1);
+        hash = xx64_merge_round(hash, lane2);
+        hash = xx64_merge_round(hash, lane3);
+        hash = xx64_merge_round(hash, lane4);
+    }
+    else {
+        hash = seed + XX64_PRIME_5;
+    }
+
+    hash += (u64)str.length;
+
+    while(at + 8 <= end) {
+        hash ^= xx64_round(0, xx64_read_u64(at));
+        hash = xx64_rotate_left(hash, 27) * XX64_PRIME_1 + XX64_PRIME_4;
+        at += 8;
+    }
+
+    if(at + 4 <= end) {
+        hash ^= (u64)xx64_read_u32(at) * XX64_PRIME_1;
+        hash = xx64_rotate_left(hash, 23) * XX64_PRIME_2 + XX64_PRIME_3;
+        at += 4;
+    }
+
+    while(at < end) {
+        hash ^= (u64)(*at) * XX64_PRIME_5;
+        hash = xx64_rotate_left(hash, 11) * XX64_PRIME_1;
+        at++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XX64_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= XX64_PRIME_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
 template<typename Token, typename UntilFx, typename Context = void>
 intern 
 String tokenizer_read_until(
@@ -3917,7 +4223,7 @@ Array<T> make_array(s64 num_starting_elements,
 
     if(num_starting_elements > 0) {
         ret.num_starting_elements = num_starting_elements;
-        ret.page = memory_allocator_allocate(allocator, sizeof(T) * num_starting_elements, "make_array");
+        ret.page = memory_allocator_allocate_aligned(allocator, sizeof(T) * num_starting_elements, alignof(T), "make_array");
         ret.storage = (T*)ret.page.data;
     }
     else {
@@ -3974,10 +4280,10 @@ void array_reserve(Array<T> * arr, s32 num_elements) {
 
         Memory_Allocation new_page;
         if(allocation_equals(&arr->page, &null_page)) {
-            new_page = memory_allocator_allocate(arr->allocator, new_desired_size_in_bytes, "Array<T> rellocation (array initial size was 0 so this is the first allocation actually");
+            new_page = memory_allocator_allocate_aligned(arr->allocator, new_desired_size_in_bytes, alignof(T), "Array<T> rellocation (array initial size was 0 so this is the first allocation actually");
         }
         else {
-            new_page = memory_allocator_reallocate(arr->allocator, arr->page, new_desired_size_in_bytes, "Array<T> reallocation");
+            new_page = memory_allocator_reallocate_aligned(arr->allocator, arr->page, new_desired_size_in_bytes, alignof(T), "Array<T> reallocation");
         }
             
         if(arr->log_reallocation) {
@@ -5331,6 +5637,13 @@ void table_free(Table<T> * table) {
     table->max_storage_elements = 0;
 }
 
+template<typename T>
+intern force_inline
+void table_clear(Table<T> * table) {
+    set_bytes((u8*)table->page.data, 0, table->page.length);
+    table->watermark = 0;
+}
+
 template<typename T>
 intern force_inline
 s64 table_calc_max_elements(Table<T> * table, Memory_Allocation page) {
@@ -5353,7 +5666,7 @@ Table<T> make_table(
     ret.allocator = allocator;
     ret.watermark = 0;
 
-    auto page = memory_allocator_allocate(allocator, sizeof(*ret.storage) * num_starting_elements, "make_table");
+    auto page = memory_allocator_allocate_aligned(allocator, sizeof(*ret.storage) * num_starting_elements, alignof(Table_Entry<T>), "make_table");
     set_bytes((u8*)page.data, 0, page.length);
     
     ret.page = page;
@@ -5415,9 +5728,11 @@ T * table_insert(
         b32 * opt_out_did_insert = 0
 ) {
     if(table->watermark >= table->max_storage_elements) {
+        TRACE_ZONE("table_insert grow");
+
         auto new_page_size = table->num_starting_elements * sizeof(*table->storage) + table->page.length;
 
-        auto new_page = memory_allocator_allocate(table->allocator, new_page_size, "table_insert");
+        auto new_page = memory_allocator_allocate_aligned(table->allocator, new_page_size, alignof(Table_Entry<T>), "table_insert");
         set_bytes((u8*)new_page.data, 0, new_page.length);
         auto new_max_elements = table_calc_max_elements(table, new_page);
 
@@ -5785,11 +6100,79 @@ struct Memory_Allocator_Tracked {
     Memory_Allocator * allocator;
 };
 
+// NOTE(justas): the header at the start of every block a chained arena gets from the platform.
+struct Arena_Block {
+    Arena_Block * previous;
+    Memory_Allocation page;
+    s64 top;
+};
+
+// NOTE(justas): an arena that chains on another block instead of running out. Resetting it
+// folds the chain back into one block big enough for what got used lately, and gives memory
+// back once a spike has been over for a while.
+struct Memory_Allocator_Chained_Arena {
+    Arena_Block * current;
+    s64 block_size;
+
+    s64 used;
+    s64 peak_since_reset;
+    s64 recent_peak;
+    s64 high_water;
+
+    s64 num_blocks;
+    s64 reserved;
+};
+
+// NOTE(justas): an arena sitting on a big reservation that commits pages as top moves up.
+// Nothing in it ever moves, so the top allocation can keep growing in place.
+struct Memory_Allocator_Virtual_Arena {
+    Memory_Allocation reservation;
+    s64 top;
+    s64 committed;
+    s64 commit_size;
+    b32 should_decommit_on_reset;
+};
+
+#define POOL_MIN_SLOT_SIZE 16
+#define POOL_MAX_SLOT_SIZE KILOBYTES(4)
+#define POOL_NUM_SIZE_CLASSES 9
+#define POOL_SLAB_HEADER_SIZE 64
+
+struct Pool_Free_Slot {
+    Pool_Free_Slot * next;
+};
+
+struct Pool_Slab_Header {
+    s64 size_class;
+};
+
+// NOTE(justas): power of two size classes from 16 bytes to 4KB. Every slab holds one class and
+// sits at a slab_size multiple inside one reservation, so a free finds its class from the
+// address alone. Anything bigger goes straight to the os and is remembered in a table, so
+// freeing the pool frees everything it ever handed out. Freeing memory the pool doesn't own
+// is ignored, same as the tracked allocator. Not thread safe.
+struct Memory_Allocator_Pool {
+    Memory_Allocation reservation;
+    s64 slab_size;
+    s64 num_slabs;
+
+    Pool_Free_Slot * free_slots[POOL_NUM_SIZE_CLASSES];
+    u8 * bump[POOL_NUM_SIZE_CLASSES];
+    u8 * bump_end[POOL_NUM_SIZE_CLASSES];
+
+    Table<Memory_Allocation> large_allocations;
+
+    s64 num_live_slots;
+};
+
 enum MEMORY_ALLOCATOR_TYPE_ {
     MEMORY_ALLOCATOR_TYPE_ARENA,
     MEMORY_ALLOCATOR_TYPE_PAGE,
     MEMORY_ALLOCATOR_TYPE_TRACKED,
     MEMORY_ALLOCATOR_TYPE_MALLOC,
+    MEMORY_ALLOCATOR_TYPE_CHAINED_ARENA,
+    MEMORY_ALLOCATOR_TYPE_VIRTUAL_ARENA,
+    MEMORY_ALLOCATOR_TYPE_POOL,
 };
 
 struct Memory_Allocator {
@@ -5798,9 +6181,14 @@ struct Memory_Allocator {
     union {
         Memory_Allocator_Arena arena;
         Memory_Allocator_Tracked tracked;
+        Memory_Allocator_Chained_Arena chained;
+        Memory_Allocator_Virtual_Arena virt;
+        Memory_Allocator_Pool pool;
     };
 };
 
+#define ARENA_BLOCK_HEADER_SIZE ((s64)((sizeof(Arena_Block) + 15) & ~15))
+
 intern force_inline
 Memory_Allocator make_tracked_memory_allocator(Memory_Allocator * allocator) {
     Memory_Allocator ret;
@@ -5846,101 +6234,412 @@ Memory_Allocator make_malloc_memory_allocator() {
 }
 
 
-intern force_inline
-void memory_allocator_arena_reset(Memory_Allocator * allocator) {
-    assert(allocator->type == MEMORY_ALLOCATOR_TYPE_ARENA);
-
-    allocator->arena.top = 0;
-}
+intern
+Arena_Block * chained_arena_push_block(Memory_Allocator_Chained_Arena * arena, s64 min_size) {
+    auto size = MAX(arena->block_size, min_size + ARENA_BLOCK_HEADER_SIZE);
 
-intern force_inline
-Memory_Allocator make_arena_memory_allocator(Memory_Allocation page) {
-    Memory_Allocator ret;
+    auto page = plat_mem_allocate(size);
+    auto * block = (Arena_Block*)page.data;
+    block->previous = arena->current;
+    block->page = page;
+    block->top = ARENA_BLOCK_HEADER_SIZE;
 
-    ret.type = MEMORY_ALLOCATOR_TYPE_ARENA;
-    ret.arena.top = 0;
-    ret.arena.page = page;
-    ret.arena.storage = ret.arena.page.data;
+    arena->current = block;
+    arena->num_blocks++;
+    arena->reserved += page.length;
 
-    return ret;
+    return block;
 }
 
 intern
-Array<String> string_split(
-        String str, 
-        char split_at,
-        Memory_Allocator * temp
-) {
-    auto strs = make_array<String>(1, temp, "string_split"_S);
+void chained_arena_free_blocks(Memory_Allocator_Chained_Arena * arena) {
+    auto * block = arena->current;
+    while(block) {
+        auto * previous = block->previous;
+        plat_mem_free(block->page);
+        block = previous;
+    }
 
-    s64 prev_split_at_index = 0;
-    auto had_to_split = false;
-    for(auto char_index = 0;
-            char_index < str.length;
-            char_index++
-    ) {
-        auto c = str.str[char_index];
+    arena->current = 0;
+    arena->num_blocks = 0;
+    arena->reserved = 0;
+}
 
-        if(c == split_at) {
-            had_to_split = true;
-            *array_append(&strs) = make_string(str.str + prev_split_at_index, char_index - prev_split_at_index);
-            prev_split_at_index = char_index + 1; // NOTE(justas): +1 so we ignore the split_at char
-        }
+intern
+b32 virtual_arena_commit_up_to(Memory_Allocator_Virtual_Arena * arena, s64 new_top) {
+    if(new_top <= arena->committed) {
+        return true;
     }
 
-    if(had_to_split) {
-        *array_append(&strs) = make_string(str.str + prev_split_at_index, str.length - prev_split_at_index);
+    if(new_top > arena->reservation.length) {
+        return false;
     }
 
-    return strs;
-}
+    auto new_committed = ((new_top + arena->commit_size - 1) / arena->commit_size) * arena->commit_size;
+    new_committed = MIN(new_committed, arena->reservation.length);
 
-intern force_inline
-Memory_Allocator make_arena_memory_allocator_dynamically_allocated(s64 size) {
-    return make_arena_memory_allocator(plat_mem_allocate(size));
-}
+    plat_mem_commit((u8*)arena->reservation.data + arena->committed, new_committed - arena->committed);
+    arena->committed = new_committed;
 
-intern
-Memory_Allocation memory_allocator_allocate(
-        Memory_Allocator * generic_allocator, 
-        s64 num_bytes, 
-        const char * reason
-) {
+    return true;
+}
 
-    switch(generic_allocator->type) {
-        case MEMORY_ALLOCATOR_TYPE_MALLOC: {
-            Memory_Allocation page = {};
-            page.length = num_bytes;
-            page.data = malloc(num_bytes);
-            return page;
+intern force_inline
+void memory_allocator_arena_reset(Memory_Allocator * allocator) {
+    if(allocator->type == MEMORY_ALLOCATOR_TYPE_VIRTUAL_ARENA) {
+        auto * arena = &allocator->virt;
+        arena->top = 0;
+
+        // NOTE(justas): keeps the first commit around so the next frame doesn't fault right away.
+        if(arena->should_decommit_on_reset && arena->committed > arena->commit_size) {
+            plat_mem_decommit((u8*)arena->reservation.data + arena->commit_size, arena->committed - arena->commit_size);
+            arena->committed = arena->commit_size;
         }
-        case MEMORY_ALLOCATOR_TYPE_TRACKED: {
-            auto * alloc = &generic_allocator->tracked;
-            auto page = memory_allocator_allocate(alloc->allocator, num_bytes, reason);
 
-            *table_insert(&alloc->allocations, (u64)page.data) = page;
+        return;
+    }
 
-            return page;
-        }
-        case MEMORY_ALLOCATOR_TYPE_ARENA: {
-            auto * allocator = &generic_allocator->arena;
-            s64 new_top = allocator->top + num_bytes;
+    if(allocator->type == MEMORY_ALLOCATOR_TYPE_CHAINED_ARENA) {
+        auto * arena = &allocator->chained;
 
-            if(new_top > allocator->page.length) {
-                printf("arena allocator ran out of memory. allocation reason: '%s'\n", reason);
-                assert(false);
-            }
+        // NOTE(justas): a spike keeps its memory around for a while, it'll likely come back.
+        arena->recent_peak = MAX(arena->peak_since_reset, arena->recent_peak - arena->recent_peak / 16);
 
-            Memory_Allocation ret;
+        auto wanted = arena->recent_peak + ARENA_BLOCK_HEADER_SIZE;
+        wanted = ((wanted + arena->block_size - 1) / arena->block_size) * arena->block_size;
+
+        auto is_chained = arena->num_blocks > 1;
+        auto is_bloated = arena->reserved > wanted * 2;
+
+        if(is_chained || is_bloated) {
+            chained_arena_free_blocks(arena);
+            chained_arena_push_block(arena, wanted - ARENA_BLOCK_HEADER_SIZE);
+        }
+        else if(arena->current) {
+            arena->current->top = ARENA_BLOCK_HEADER_SIZE;
+        }
+
+        arena->used = 0;
+        arena->peak_since_reset = 0;
+        return;
+    }
+
+    assert(allocator->type == MEMORY_ALLOCATOR_TYPE_ARENA);
+
+    allocator->arena.top = 0;
+}
+
+// NOTE(justas): block_size is what it starts with and the granularity it grows and shrinks by.
+intern
+Memory_Allocator make_chained_arena_memory_allocator(s64 block_size) {
+    Memory_Allocator ret;
+
+    ret.type = MEMORY_ALLOCATOR_TYPE_CHAINED_ARENA;
+    ret.chained = {};
+    ret.chained.block_size = block_size;
+    chained_arena_push_block(&ret.chained, block_size - ARENA_BLOCK_HEADER_SIZE);
+
+    return ret;
+}
+
+intern
+void free_chained_arena_memory_allocator(Memory_Allocator * allocator) {
+    assert(allocator->type == MEMORY_ALLOCATOR_TYPE_CHAINED_ARENA);
+    chained_arena_free_blocks(&allocator->chained);
+}
+
+// NOTE(justas): reserve_size is only address space, so it can be huge. commit_size has to be
+// a multiple of the page size.
+intern
+Memory_Allocator make_virtual_arena_memory_allocator(
+        s64 reserve_size, 
+        b32 should_decommit_on_reset, 
+        s64 commit_size = KILOBYTES(64)
+) {
+    Memory_Allocator ret;
+
+    ret.type = MEMORY_ALLOCATOR_TYPE_VIRTUAL_ARENA;
+    ret.virt = {};
+    ret.virt.reservation = plat_mem_reserve(reserve_size);
+    ret.virt.commit_size = commit_size;
+    ret.virt.should_decommit_on_reset = should_decommit_on_reset;
+
+    return ret;
+}
+
+intern
+void free_virtual_arena_memory_allocator(Memory_Allocator * allocator) {
+    assert(allocator->type == MEMORY_ALLOCATOR_TYPE_VIRTUAL_ARENA);
+    plat_mem_free(allocator->virt.reservation);
+    allocator->virt = {};
+}
+
+intern force_inline
+s64 pool_get_size_class(s64 num_bytes) {
+    s64 size_class = 0;
+    s64 slot_size = POOL_MIN_SLOT_SIZE;
+
+    while(slot_size < num_bytes) {
+        slot_size <<= 1;
+        size_class++;
+    }
+
+    return size_class;
+}
+
+intern force_inline
+s64 pool_get_slot_size(s64 size_class) {
+    return (s64)POOL_MIN_SLOT_SIZE << size_class;
+}
+
+intern force_inline
+b32 pool_owns_slot(Memory_Allocator_Pool * pool, void * data) {
+    auto * base = (u8*)pool->reservation.data;
+    return (u8*)data >= base && (u8*)data < base + pool->num_slabs * pool->slab_size;
+}
+
+intern
+void pool_push_slab(Memory_Allocator_Pool * pool, s64 size_class) {
+    if((pool->num_slabs + 1) * pool->slab_size > pool->reservation.length) {
+        printf("pool allocator ran out of address space for slabs\n");
+        assert(false);
+    }
+
+    auto * slab = (u8*)pool->reservation.data + pool->num_slabs * pool->slab_size;
+    plat_mem_commit(slab, pool->slab_size);
+    pool->num_slabs++;
+
+    ((Pool_Slab_Header*)slab)->size_class = size_class;
+
+    // NOTE(justas): slots are aligned to their own size, slabs to a page.
+    auto slot_size = pool_get_slot_size(size_class);
+    pool->bump[size_class] = slab + MAX((s64)POOL_SLAB_HEADER_SIZE, slot_size);
+    pool->bump_end[size_class] = slab + pool->slab_size;
+}
+
+// NOTE(justas): the page allocator has no state, so every pool can share this one.
+intern Memory_Allocator pool_large_allocation_allocator = make_page_memory_allocator();
+
+// NOTE(justas): slab_size has to be a multiple of the page size and fit the biggest slot.
+intern
+Memory_Allocator make_pool_memory_allocator(
+        s64 slab_size = KILOBYTES(64), 
+        s64 reserve_size = GIGABYTES((s64)4)
+) {
+    assert(slab_size >= POOL_MAX_SLOT_SIZE * 2);
+
+    Memory_Allocator ret;
+
+    ret.type = MEMORY_ALLOCATOR_TYPE_POOL;
+    ret.pool = {};
+    ret.pool.reservation = plat_mem_reserve(reserve_size);
+    ret.pool.slab_size = slab_size;
+    ret.pool.large_allocations = make_table<Memory_Allocation>(16, &pool_large_allocation_allocator, "pool large allocations"_S);
+
+    return ret;
+}
+
+intern
+void free_pool_memory_allocator(Memory_Allocator * allocator) {
+    assert(allocator->type == MEMORY_ALLOCATOR_TYPE_POOL);
+    auto * pool = &allocator->pool;
+
+    For(pool->large_allocations) {
+        plat_mem_free(it->value);
+    }
+    table_free(&pool->large_allocations);
+
+    plat_mem_free(pool->reservation);
+    *pool = {};
+}
+
+intern force_inline
+Memory_Allocator make_arena_memory_allocator(Memory_Allocation page) {
+    Memory_Allocator ret;
+
+    ret.type = MEMORY_ALLOCATOR_TYPE_ARENA;
+    ret.arena.top = 0;
+    ret.arena.page = page;
+    ret.arena.storage = ret.arena.page.data;
+
+    return ret;
+}
+
+intern
+Array<String> string_split(
+        String str, 
+        char split_at,
+        Memory_Allocator * temp
+) {
+    auto strs = make_array<String>(1, temp, "string_split"_S);
+
+    s64 prev_split_at_index = 0;
+    auto had_to_split = false;
+    for(auto char_index = 0;
+            char_index < str.length;
+            char_index++
+    ) {
+        auto c = str.str[char_index];
+
+        if(c == split_at) {
+            had_to_split = true;
+            *array_append(&strs) = make_string(str.str + prev_split_at_index, char_index - prev_split_at_index);
+            prev_split_at_index = char_index + 1; // NOTE(justas): +1 so we ignore the split_at char
+        }
+    }
+
+    if(had_to_split) {
+        *array_append(&strs) = make_string(str.str + prev_split_at_index, str.length - prev_split_at_index);
+    }
+
+    return strs;
+}
+
+intern force_inline
+Memory_Allocator make_arena_memory_allocator_dynamically_allocated(s64 size) {
+    return make_arena_memory_allocator(plat_mem_allocate(size));
+}
+
+// NOTE(justas): alignment has to be a power of two. The arenas pad top up to it, everything
+// else gets it from the os or the c runtime. Page allocations can't go past the page size.
+intern
+Memory_Allocation memory_allocator_allocate_aligned(
+        Memory_Allocator * generic_allocator, 
+        s64 num_bytes, 
+        s64 alignment,
+        const char * reason
+) {
+    TRACE_ZONE("memory_allocator_allocate");
+
+    assert(is_power_of_two(alignment), "allocate: alignment has to be a power of two");
+
+    switch(generic_allocator->type) {
+        case MEMORY_ALLOCATOR_TYPE_MALLOC: {
+            Memory_Allocation page = {};
+            page.length = num_bytes;
+
+#if defined(IS_WINDOWS)
+            page.data = _aligned_malloc(num_bytes, MAX(alignment, (s64)MALLOC_ALIGNMENT));
+#else
+            if(alignment <= MALLOC_ALIGNMENT) {
+                page.data = malloc(num_bytes);
+            }
+            else if(posix_memalign(&page.data, alignment, num_bytes) != 0) {
+                page.data = 0;
+            }
+#endif
+            return page;
+        }
+        case MEMORY_ALLOCATOR_TYPE_TRACKED: {
+            auto * alloc = &generic_allocator->tracked;
+            auto page = memory_allocator_allocate_aligned(alloc->allocator, num_bytes, alignment, reason);
+
+            *table_insert(&alloc->allocations, (u64)page.data) = page;
+
+            return page;
+        }
+        case MEMORY_ALLOCATOR_TYPE_ARENA: {
+            auto * allocator = &generic_allocator->arena;
+            auto base = (u64)allocator->storage;
+            s64 start = align_up(base + allocator->top, alignment) - base;
+            s64 new_top = start + num_bytes;
+
+            if(new_top > allocator->page.length) {
+                printf("arena allocator ran out of memory. allocation reason: '%s'\n", reason);
+                assert(false);
+            }
+
+            Memory_Allocation ret;
 
             ret.length = num_bytes;
-            ret.data = (u8*)allocator->storage + allocator->top;
+            ret.data = (u8*)allocator->storage + start;
 
             allocator->top = new_top;
 
             return ret;
         }
+        case MEMORY_ALLOCATOR_TYPE_CHAINED_ARENA: {
+            auto * arena = &generic_allocator->chained;
+            auto * block = arena->current;
+
+            // NOTE(justas): blocks are page aligned, so aligning the offset aligns the address.
+            s64 start = block ? align_up(block->top, alignment) : 0;
+
+            if(!block || start + num_bytes > block->page.length) {
+                block = chained_arena_push_block(arena, num_bytes + alignment);
+                start = align_up(block->top, alignment);
+            }
+
+            Memory_Allocation ret;
+            ret.length = num_bytes;
+            ret.data = (u8*)block + start;
+
+            arena->used += (start - block->top) + num_bytes;
+            block->top = start + num_bytes;
+
+            arena->peak_since_reset = MAX(arena->peak_since_reset, arena->used);
+            arena->high_water = MAX(arena->high_water, arena->used);
+
+            return ret;
+        }
+        case MEMORY_ALLOCATOR_TYPE_VIRTUAL_ARENA: {
+            auto * arena = &generic_allocator->virt;
+            s64 start = align_up(arena->top, alignment);
+            s64 new_top = start + num_bytes;
+
+            if(!virtual_arena_commit_up_to(arena, new_top)) {
+                printf("virtual arena ran out of address space. allocation reason: '%s'\n", reason);
+                assert(false);
+            }
+
+            Memory_Allocation ret;
+
+            ret.length = num_bytes;
+            ret.data = (u8*)arena->reservation.data + start;
+
+            arena->top = new_top;
+
+            return ret;
+        }
+        case MEMORY_ALLOCATOR_TYPE_POOL: {
+            auto * pool = &generic_allocator->pool;
+            auto slot_bytes = MAX(num_bytes, alignment);
+
+            Memory_Allocation ret;
+
+            if(slot_bytes > POOL_MAX_SLOT_SIZE) {
+                assert(alignment <= KILOBYTES(4), "allocate: big pool allocations can't be aligned past a page");
+
+                ret = plat_mem_allocate(num_bytes);
+                *table_insert(&pool->large_allocations, (u64)ret.data) = ret;
+                return ret;
+            }
+
+            auto size_class = pool_get_size_class(slot_bytes);
+            auto slot_size = pool_get_slot_size(size_class);
+
+            if(pool->free_slots[size_class]) {
+                auto * slot = pool->free_slots[size_class];
+                pool->free_slots[size_class] = slot->next;
+                ret.data = slot;
+            }
+            else {
+                if(pool->bump[size_class] + slot_size > pool->bump_end[size_class]) {
+                    pool_push_slab(pool, size_class);
+                }
+
+                ret.data = pool->bump[size_class];
+                pool->bump[size_class] += slot_size;
+            }
+
+            pool->num_live_slots++;
+
+            // NOTE(justas): hands out the whole slot so arrays can grow into it for free.
+            ret.length = slot_size;
+            return ret;
+        }
         case MEMORY_ALLOCATOR_TYPE_PAGE: {
+            assert(alignment <= KILOBYTES(4), "allocate: page allocations can't be aligned past a page");
             return plat_mem_allocate(num_bytes);
         }
         default: {
@@ -5951,6 +6650,15 @@ Memory_Allocation memory_allocator_allocate(
     return null_page;
 }
 
+intern force_inline
+Memory_Allocation memory_allocator_allocate(
+        Memory_Allocator * generic_allocator, 
+        s64 num_bytes, 
+        const char * reason
+) {
+    return memory_allocator_allocate_aligned(generic_allocator, num_bytes, 1, reason);
+}
+
 intern
 void memory_allocator_free(
         Memory_Allocator * generic_allocator, 
@@ -5962,7 +6670,11 @@ void memory_allocator_free(
 
     switch(generic_allocator->type) {
         case MEMORY_ALLOCATOR_TYPE_MALLOC: {
+#if defined(IS_WINDOWS)
+            _aligned_free(allocation.data);
+#else
             free(allocation.data);
+#endif
             break;
         }
         case MEMORY_ALLOCATOR_TYPE_TRACKED: {
@@ -5990,6 +6702,52 @@ void memory_allocator_free(
 
             break;
         }
+        case MEMORY_ALLOCATOR_TYPE_CHAINED_ARENA: {
+            auto * arena = &generic_allocator->chained;
+            auto * block = arena->current;
+
+            if((u8*)allocation.data + allocation.length == (u8*)block + block->top) {
+                block->top -= allocation.length;
+                arena->used -= allocation.length;
+            }
+
+            break;
+        }
+        case MEMORY_ALLOCATOR_TYPE_VIRTUAL_ARENA: {
+            auto * arena = &generic_allocator->virt;
+
+            if((u8*)allocation.data + allocation.length == (u8*)arena->reservation.data + arena->top) {
+                arena->top -= allocation.length;
+            }
+
+            break;
+        }
+        case MEMORY_ALLOCATOR_TYPE_POOL: {
+            auto * pool = &generic_allocator->pool;
+
+            // NOTE(justas): strings get freed with their own length, so the class comes from the slab.
+            if(pool_owns_slot(pool, allocation.data)) {
+                auto slab_index = ((u8*)allocation.data - (u8*)pool->reservation.data) / pool->slab_size;
+                auto * slab = (Pool_Slab_Header*)((u8*)pool->reservation.data + slab_index * pool->slab_size);
+
+                auto * slot = (Pool_Free_Slot*)allocation.data;
+                slot->next = pool->free_slots[slab->size_class];
+                pool->free_slots[slab->size_class] = slot;
+
+                pool->num_live_slots--;
+                break;
+            }
+
+            auto key = (u64)allocation.data;
+            auto * large = table_get(&pool->large_allocations, key);
+            if(!large) {
+                break;
+            }
+
+            plat_mem_free(*large);
+            table_remove(&pool->large_allocations, key);
+            break;
+        }
         case MEMORY_ALLOCATOR_TYPE_PAGE: {
             plat_mem_free(allocation);
             break;
@@ -6001,20 +6759,124 @@ void memory_allocator_free(
 }
 
 intern
-Memory_Allocation memory_allocator_reallocate(
+Memory_Allocation memory_allocator_reallocate_aligned(
         Memory_Allocator * void_allocator, 
         Memory_Allocation allocation, 
         s64 new_size, 
+        s64 alignment,
         const char* reason
 ) {
     if(allocation.length >= new_size) {
         return allocation;
     }
 
-    auto new_allocation = memory_allocator_allocate(void_allocator, new_size, reason);
-    if(allocation.data == 0) {
-        return new_allocation;
-    }
+    if(allocation.data == 0) {
+        return memory_allocator_allocate_aligned(void_allocator, new_size, alignment, reason);
+    }
+
+    TRACE_ZONE("memory_allocator_reallocate");
+
+    auto * end = (u8*)allocation.data + allocation.length;
+    auto delta = new_size - allocation.length;
+
+    // NOTE(justas): grow in place whenever the allocator lets us, copying is the fallback.
+    switch(void_allocator->type) {
+        case MEMORY_ALLOCATOR_TYPE_MALLOC: {
+            Memory_Allocation ret;
+            ret.length = new_size;
+
+#if defined(IS_WINDOWS)
+            ret.data = _aligned_realloc(allocation.data, new_size, MAX(alignment, (s64)MALLOC_ALIGNMENT));
+            return ret;
+#else
+            // NOTE(justas): realloc only promises malloc's alignment.
+            if(alignment <= MALLOC_ALIGNMENT) {
+                ret.data = realloc(allocation.data, new_size);
+                return ret;
+            }
+#endif
+            break;
+        }
+        case MEMORY_ALLOCATOR_TYPE_TRACKED: {
+            auto * alloc = &void_allocator->tracked;
+            auto old_key = (u64)allocation.data;
+
+            if(!table_get(&alloc->allocations, old_key)) {
+                break;
+            }
+
+            auto ret = memory_allocator_reallocate_aligned(alloc->allocator, allocation, new_size, alignment, reason);
+
+            if(ret.data != allocation.data) {
+                table_remove(&alloc->allocations, old_key);
+            }
+            *table_insert(&alloc->allocations, (u64)ret.data) = ret;
+
+            return ret;
+        }
+        case MEMORY_ALLOCATOR_TYPE_ARENA: {
+            auto * arena = &void_allocator->arena;
+
+            if(end == (u8*)arena->storage + arena->top && arena->top + delta <= arena->page.length) {
+                arena->top += delta;
+                allocation.length = new_size;
+                return allocation;
+            }
+            break;
+        }
+        case MEMORY_ALLOCATOR_TYPE_CHAINED_ARENA: {
+            auto * arena = &void_allocator->chained;
+            auto * block = arena->current;
+
+            if(end == (u8*)block + block->top && block->top + delta <= block->page.length) {
+                block->top += delta;
+
+                arena->used += delta;
+                arena->peak_since_reset = MAX(arena->peak_since_reset, arena->used);
+                arena->high_water = MAX(arena->high_water, arena->used);
+
+                allocation.length = new_size;
+                return allocation;
+            }
+            break;
+        }
+        case MEMORY_ALLOCATOR_TYPE_VIRTUAL_ARENA: {
+            auto * arena = &void_allocator->virt;
+
+            // NOTE(justas): the top of a virtual arena just grows, it never has to move.
+            if(end == (u8*)arena->reservation.data + arena->top && virtual_arena_commit_up_to(arena, arena->top + delta)) {
+                arena->top += delta;
+                allocation.length = new_size;
+                return allocation;
+            }
+            break;
+        }
+        case MEMORY_ALLOCATOR_TYPE_POOL: {
+            auto * pool = &void_allocator->pool;
+
+            // NOTE(justas): big ones get remapped, then rekeyed.
+            auto old_key = (u64)allocation.data;
+            auto * large = table_get(&pool->large_allocations, old_key);
+
+            if(large && alignment <= KILOBYTES(4)) {
+                auto ret = plat_mem_reallocate(*large, new_size);
+
+                table_remove(&pool->large_allocations, old_key);
+                *table_insert(&pool->large_allocations, (u64)ret.data) = ret;
+
+                return ret;
+            }
+            break;
+        }
+        case MEMORY_ALLOCATOR_TYPE_PAGE: {
+            return plat_mem_reallocate(allocation, new_size);
+        }
+        default: {
+            break;
+        }
+    }
+
+    auto new_allocation = memory_allocator_allocate_aligned(void_allocator, new_size, alignment, reason);
 
     copy_bytes((u8*)new_allocation.data, (u8*)allocation.data, allocation.length);
 
@@ -6023,6 +6885,16 @@ Memory_Allocation memory_allocator_reallocate(
     return new_allocation;
 }
 
+intern force_inline
+Memory_Allocation memory_allocator_reallocate(
+        Memory_Allocator * void_allocator, 
+        Memory_Allocation allocation, 
+        s64 new_size, 
+        const char* reason
+) {
+    return memory_allocator_reallocate_aligned(void_allocator, allocation, new_size, 1, reason);
+}
+
 intern
 String string_trim_in_place(String str) {
     String ret = str;
@@ -6079,6 +6951,35 @@ b32 does_file_exist(
 
 #if defined(IS_LINUX) 
     #include <time.h>
+    #include <pthread.h>
+
+    typedef void (*Plat_Thread_Proc)(void * data);
+
+    struct Plat_Thread {
+        pthread_t handle;
+        Plat_Thread_Proc proc;
+        void * data;
+    };
+
+    intern
+    void * plat_thread_trampoline(void * void_thread) {
+        auto * thread = (Plat_Thread*)void_thread;
+        thread->proc(thread->data);
+        return 0;
+    }
+
+    // NOTE(justas): the Plat_Thread has to outlive the thread since the trampoline reads from it.
+    intern
+    b32 plat_thread_start(Plat_Thread * thread, Plat_Thread_Proc proc, void * data) {
+        thread->proc = proc;
+        thread->data = data;
+        return pthread_create(&thread->handle, 0, plat_thread_trampoline, thread) == 0;
+    }
+
+    intern
+    void plat_thread_join(Plat_Thread * thread) {
+        pthread_join(thread->handle, 0);
+    }
 
     typedef timespec Plat_High_Frequency_Time;
 
@@ -6163,6 +7064,35 @@ b32 does_file_exist(
     }
 
 #elif defined(IS_WINDOWS)
+    typedef void (*Plat_Thread_Proc)(void * data);
+
+    struct Plat_Thread {
+        HANDLE handle;
+        Plat_Thread_Proc proc;
+        void * data;
+    };
+
+    intern
+    DWORD WINAPI plat_thread_trampoline(LPVOID void_thread) {
+        auto * thread = (Plat_Thread*)void_thread;
+        thread->proc(thread->data);
+        return 0;
+    }
+
+    intern
+    b32 plat_thread_start(Plat_Thread * thread, Plat_Thread_Proc proc, void * data) {
+        thread->proc = proc;
+        thread->data = data;
+        thread->handle = CreateThread(0, 0, plat_thread_trampoline, thread, 0, 0);
+        return thread->handle != 0;
+    }
+
+    intern
+    void plat_thread_join(Plat_Thread * thread) {
+        WaitForSingleObject(thread->handle, INFINITE);
+        CloseHandle(thread->handle);
+    }
+
     intern
     void open_process_or_url(
             String path,
@@ -6422,7 +7352,8 @@ intern
 Bucket_Pool_Bucket<T> * bucket_pool_alloc_new_bucket(Bucket_Pool<T> * pool) {
     auto * bucket = array_append(&pool->buckets);
 
-    auto storage_page = m_new(pool->alloc, pool->bucket_size * sizeof(T));
+    // NOTE(justas): buckets start on a cache line so neighbouring pools don't share one.
+    auto storage_page = memory_allocator_allocate_aligned(pool->alloc, pool->bucket_size * sizeof(T), MAX((s64)alignof(T), (s64)CACHE_LINE_SIZE), "bucket pool storage");
     auto is_free_page = m_new(pool->alloc, (s64)ceil_f64((f64)pool->bucket_size / (f64)sizeof(*bucket->is_free)));
 
     bucket->storage = (T*)storage_page.data;
@@ -6534,6 +7465,226 @@ void bucket_pool_destroy_object(
     bucket->free_slots++;
 }
 
+// NOTE(justas): single producer, single consumer ring. The producer is the only one that writes
+// write_index and the consumer is the only one that writes read_index so neither side ever has to
+// take a lock. The padding keeps the two indices on separate cache lines.
+template<typename T>
+struct Spsc_Queue {
+    T * storage;
+    s64 capacity;
+
+    Memory_Allocation page;
+    Memory_Allocator * allocator;
+
+    u8 pad0[64];
+    s64 write_index;
+    u8 pad1[64];
+    s64 read_index;
+    u8 pad2[64];
+};
+
+template<typename T>
+intern
+Spsc_Queue<T> make_spsc_queue(
+        s64 capacity,
+        Memory_Allocator * allocator
+) {
+    assert(is_power_of_two(capacity), "spsc queue capacity has to be a power of two");
+
+    Spsc_Queue<T> ret = {};
+    ret.allocator = allocator;
+    ret.capacity = capacity;
+    ret.page = memory_allocator_allocate(allocator, capacity * sizeof(T), "spsc queue storage");
+    ret.storage = (T*)ret.page.data;
+
+    return ret;
+}
+
+template<typename T>
+intern
+void spsc_queue_free(Spsc_Queue<T> * queue) {
+    memory_allocator_free(queue->allocator, queue->page);
+    queue->storage = 0;
+    queue->page = null_page;
+}
+
+template<typename T>
+intern
+b32 spsc_queue_push(Spsc_Queue<T> * queue, T value) {
+    auto write = queue->write_index;
+    auto read = atomic_fetch(&queue->read_index);
+
+    if(write - read >= queue->capacity) {
+        return false;
+    }
+
+    queue->storage[write & (queue->capacity - 1)] = value;
+    atomic_store(&queue->write_index, write + 1);
+
+    return true;
+}
+
+template<typename T>
+intern
+b32 spsc_queue_pop(Spsc_Queue<T> * queue, T * out_value) {
+    auto read = queue->read_index;
+    auto write = atomic_fetch(&queue->write_index);
+
+    if(read == write) {
+        return false;
+    }
+
+    *out_value = queue->storage[read & (queue->capacity - 1)];
+    atomic_store(&queue->read_index, read + 1);
+
+    return true;
+}
+
+#if defined(STORMY_TRACE)
+
+struct Trace_Record {
+    const char * name;
+    f64 start;
+    f64 end;
+    s64 thread;
+};
+
+#define MAX_TRACE_THREADS 32
+#define TRACE_RING_CAPACITY (1 << 16)
+
+struct Trace_Thread {
+    Spsc_Queue<Trace_Record> ring;
+    s64 index;
+    s64 num_dropped;
+};
+
+struct Trace_State {
+    b32 is_recording;
+    timespec epoch;
+
+    Trace_Thread * threads[MAX_TRACE_THREADS];
+    s64 num_threads;
+
+    Memory_Allocator allocator;
+};
+
+intern Trace_State trace_state = {};
+
+// NOTE(justas): the thread's own ring, or 0 when it couldn't get one. While a thread sets up its
+// ring it would otherwise trace the allocations for that ring.
+intern thread_local Trace_Thread * trace_thread = 0;
+intern thread_local b32 is_trace_thread_registering = false;
+
+intern
+b32 trace_is_recording() {
+    return atomic_fetch(&trace_state.is_recording);
+}
+
+intern
+f64 trace_now() {
+    return plat_get_time_delta_in_seconds(plat_get_high_frequency_time(), trace_state.epoch);
+}
+
+intern
+Trace_Thread * trace_register_thread() {
+    auto index = atomic_fetch_add(&trace_state.num_threads, (s64)1);
+    if(index >= MAX_TRACE_THREADS) {
+        return 0;
+    }
+
+    is_trace_thread_registering = true;
+
+    // NOTE(justas): the threads never give these back, readers might still be draining them.
+    auto page = memory_allocator_allocate(&trace_state.allocator, sizeof(Trace_Thread), "trace thread");
+    auto * thread = (Trace_Thread*)page.data;
+    *thread = {};
+    thread->index = index;
+    thread->ring = make_spsc_queue<Trace_Record>(TRACE_RING_CAPACITY, &trace_state.allocator);
+
+    is_trace_thread_registering = false;
+
+    atomic_store(&trace_state.threads[index], thread);
+    return thread;
+}
+
+intern
+void trace_record_zone(const char * name, f64 start, f64 end) {
+    if(is_trace_thread_registering) {
+        return;
+    }
+
+    if(!trace_thread) {
+        trace_thread = trace_register_thread();
+
+        if(!trace_thread) {
+            return;
+        }
+    }
+
+    Trace_Record record;
+    record.name = name;
+    record.start = start;
+    record.end = end;
+    record.thread = trace_thread->index;
+
+    // NOTE(justas): nobody drained us in time, losing zones beats stalling the thread.
+    if(!spsc_queue_push(&trace_thread->ring, record)) {
+        atomic_store(&trace_thread->num_dropped, trace_thread->num_dropped + 1);
+    }
+}
+
+intern
+void trace_start() {
+    if(trace_state.allocator.type != MEMORY_ALLOCATOR_TYPE_MALLOC) {
+        trace_state.allocator = make_malloc_memory_allocator();
+        trace_state.epoch = plat_get_high_frequency_time();
+    }
+
+    atomic_store(&trace_state.is_recording, (b32)true);
+}
+
+intern
+void trace_stop() {
+    atomic_store(&trace_state.is_recording, (b32)false);
+}
+
+// NOTE(justas): only ever call this from one thread, it's the consumer side of every ring.
+intern
+void trace_drain(Array<Trace_Record> * into) {
+    auto num_threads = MIN(atomic_fetch(&trace_state.num_threads), (s64)MAX_TRACE_THREADS);
+
+    ForRange(index, 0, num_threads) {
+        auto * thread = atomic_fetch(&trace_state.threads[index]);
+
+        // NOTE(justas): claimed the slot but hasn't published the ring yet.
+        if(!thread) {
+            continue;
+        }
+
+        Trace_Record record;
+        while(spsc_queue_pop(&thread->ring, &record)) {
+            *array_append(into) = record;
+        }
+    }
+}
+
+intern
+s64 trace_get_num_dropped() {
+    s64 ret = 0;
+    auto num_threads = MIN(atomic_fetch(&trace_state.num_threads), (s64)MAX_TRACE_THREADS);
+
+    ForRange(index, 0, num_threads) {
+        auto * thread = atomic_fetch(&trace_state.threads[index]);
+        if(thread) {
+            ret += atomic_fetch(&thread->num_dropped);
+        }
+    }
+
+    return ret;
+}
+
+#endif
+
 #if defined (TESTING)
 
 intern Memory_Allocator global_test_allocator = make_page_memory_allocator();
@@ -6619,6 +7770,316 @@ TEST(object_pool) {
     }
 }
 
+TEST(spsc_queue) {
+    auto queue = make_spsc_queue<s64>(4, &global_test_allocator);
+
+    s64 val = 0;
+    assert(!spsc_queue_pop(&queue, &val));
+
+    ForRange(index, 0, 4) {
+        assert(spsc_queue_push(&queue, index));
+    }
+    assert(!spsc_queue_push(&queue, (s64)4));
+
+    ForRange(index, 0, 2) {
+        assert(spsc_queue_pop(&queue, &val));
+        assert(val == index);
+    }
+
+    // NOTE(justas): wraps around the end of the storage
+    assert(spsc_queue_push(&queue, (s64)4));
+    assert(spsc_queue_push(&queue, (s64)5));
+    assert(!spsc_queue_push(&queue, (s64)6));
+
+    ForRange(index, 2, 6) {
+        assert(spsc_queue_pop(&queue, &val));
+        assert(val == index);
+    }
+    assert(!spsc_queue_pop(&queue, &val));
+
+    spsc_queue_free(&queue);
+}
+
+#if defined(STORMY_TRACE)
+intern
+void trace_test_thread(void * data) {
+    ForRange(index, 0, 100) {
+        TRACE_ZONE("trace_test_thread");
+    }
+}
+
+TEST(trace_zones) {
+    {
+        TRACE_ZONE("not recording");
+    }
+
+    trace_start();
+
+    {
+        TRACE_ZONE("outer");
+        TRACE_ZONE("inner");
+    }
+
+    Plat_Thread thread;
+    assert(plat_thread_start(&thread, trace_test_thread, 0));
+    plat_thread_join(&thread);
+
+    trace_stop();
+
+    {
+        TRACE_ZONE("stopped");
+    }
+
+    auto records = make_array<Trace_Record>(8, &global_test_allocator, "trace records"_S);
+    trace_drain(&records);
+
+    s64 num_outer = 0;
+    s64 num_thread = 0;
+    s64 num_unwanted = 0;
+
+    For(records) {
+        assert(it->end >= it->start);
+
+        auto name = make_string(it->name);
+        if(string_equals_case_sensitive(name, "outer"_S)) num_outer++;
+        if(string_equals_case_sensitive(name, "trace_test_thread"_S)) num_thread++;
+        if(string_equals_case_sensitive(name, "not recording"_S)) num_unwanted++;
+        if(string_equals_case_sensitive(name, "stopped"_S)) num_unwanted++;
+    }
+
+    assert(num_outer == 1);
+    assert(num_thread == 100);
+    assert(num_unwanted == 0);
+
+    array_free(&records);
+}
+#endif
+
+TEST(chained_arena) {
+    auto alloc = make_chained_arena_memory_allocator(KILOBYTES(4));
+    auto * arena = &alloc.chained;
+    assert(arena->num_blocks == 1);
+
+    // NOTE(justas): overflows the first block and one that's bigger than a whole block
+    auto a = memory_allocator_allocate(&alloc, KILOBYTES(3), "a");
+    auto b = memory_allocator_allocate(&alloc, KILOBYTES(3), "b");
+    auto c = memory_allocator_allocate(&alloc, KILOBYTES(10), "c");
+    set_bytes((u8*)a.data, 1, a.length);
+    set_bytes((u8*)b.data, 2, b.length);
+    set_bytes((u8*)c.data, 3, c.length);
+
+    assert(arena->num_blocks == 3);
+    assert(((u8*)a.data)[a.length - 1] == 1);
+    assert(((u8*)b.data)[0] == 2);
+    assert(arena->used == KILOBYTES(16));
+    assert(arena->high_water == KILOBYTES(16));
+
+    // NOTE(justas): folded into one block that fits the whole frame
+    memory_allocator_arena_reset(&alloc);
+    assert(arena->num_blocks == 1);
+    assert(arena->used == 0);
+    assert(arena->reserved >= KILOBYTES(16));
+
+    auto d = memory_allocator_allocate(&alloc, KILOBYTES(16), "d");
+    assert(arena->num_blocks == 1);
+
+    memory_allocator_free(&alloc, d);
+    assert(arena->used == 0);
+
+    // NOTE(justas): quiet frames give the memory back eventually
+    ForRange(index, 0, 64) {
+        memory_allocator_allocate(&alloc, 64, "small");
+        memory_allocator_arena_reset(&alloc);
+    }
+    assert(arena->num_blocks == 1);
+    assert(arena->reserved <= KILOBYTES(8));
+    assert(arena->high_water == KILOBYTES(16));
+
+    free_chained_arena_memory_allocator(&alloc);
+    assert(arena->num_blocks == 0);
+}
+
+struct alignas(32) Test_Wide_Value {
+    f32 lanes[8];
+};
+
+TEST(aligned_allocation) {
+    auto arena = make_arena_memory_allocator_dynamically_allocated(KILOBYTES(64));
+    auto chained = make_chained_arena_memory_allocator(KILOBYTES(4));
+    auto virt = make_virtual_arena_memory_allocator(MEGABYTES(16), false);
+    auto malloc_alloc = make_malloc_memory_allocator();
+    auto tracked = make_tracked_memory_allocator(&malloc_alloc);
+
+    Memory_Allocator * allocators[] = { &arena, &chained, &virt, &malloc_alloc, &tracked, &global_test_allocator };
+
+    for(auto * alloc : allocators) {
+        // NOTE(justas): knocks the arenas off any nice alignment first
+        auto str = memory_allocator_allocate(alloc, 3, "odd string");
+
+        auto wide = memory_allocator_allocate_aligned(alloc, 100, 32, "wide");
+        assert(((u64)wide.data & 31) == 0);
+
+        auto line = memory_allocator_allocate_aligned(alloc, 10, CACHE_LINE_SIZE, "line");
+        assert(((u64)line.data & (CACHE_LINE_SIZE - 1)) == 0);
+
+        auto grown = memory_allocator_reallocate_aligned(alloc, wide, 3000, 32, "grown");
+        assert(((u64)grown.data & 31) == 0);
+
+        auto arr = make_array<Test_Wide_Value>(1, alloc, "wide values"_S);
+        ForRange(index, 0, 20) {
+            array_append(&arr)->lanes[0] = (f32)index;
+        }
+        assert(((u64)arr.storage & 31) == 0);
+        assert(arr.storage[19].lanes[0] == 19.0f);
+
+        array_free(&arr);
+        memory_allocator_free(alloc, grown);
+        memory_allocator_free(alloc, line);
+        memory_allocator_free(alloc, str);
+    }
+
+    free_tracked_memory_allocator(&tracked);
+    free_virtual_arena_memory_allocator(&virt);
+    free_chained_arena_memory_allocator(&chained);
+    plat_mem_free(arena.arena.page);
+}
+
+TEST(in_place_reallocation) {
+    auto arena = make_arena_memory_allocator_dynamically_allocated(KILOBYTES(64));
+    auto chained = make_chained_arena_memory_allocator(KILOBYTES(16));
+
+    // NOTE(justas): the top allocation of an arena just moves top
+    Memory_Allocator * arenas[] = { &arena, &chained };
+    for(auto * alloc : arenas) {
+        auto mem = memory_allocator_allocate(alloc, 100, "top");
+        auto * original = mem.data;
+
+        mem = memory_allocator_reallocate(alloc, mem, 4000, "grow top");
+        assert(mem.data == original);
+        assert(mem.length == 4000);
+
+        // NOTE(justas): not the top anymore, so this one has to move
+        auto other = memory_allocator_allocate(alloc, 16, "blocker");
+        auto moved = memory_allocator_reallocate(alloc, mem, 5000, "grow buried");
+        assert(moved.data != original);
+
+        memory_allocator_free(alloc, moved);
+        memory_allocator_free(alloc, other);
+    }
+
+    // NOTE(justas): page and malloc allocations keep their contents wherever they end up
+    auto malloc_alloc = make_malloc_memory_allocator();
+    auto tracked = make_tracked_memory_allocator(&malloc_alloc);
+
+    Memory_Allocator * others[] = { &global_test_allocator, &malloc_alloc, &tracked };
+    for(auto * alloc : others) {
+        auto mem = memory_allocator_allocate(alloc, KILOBYTES(8), "contents");
+        set_bytes((u8*)mem.data, 0xab, mem.length);
+
+        mem = memory_allocator_reallocate(alloc, mem, MEGABYTES(1), "grow");
+        assert(mem.length == MEGABYTES(1));
+        assert(((u8*)mem.data)[KILOBYTES(8) - 1] == 0xab);
+        ((u8*)mem.data)[MEGABYTES(1) - 1] = 1;
+
+        memory_allocator_free(alloc, mem);
+    }
+
+    assert(tracked.tracked.allocations.watermark == 0);
+
+    free_tracked_memory_allocator(&tracked);
+    free_chained_arena_memory_allocator(&chained);
+    plat_mem_free(arena.arena.page);
+}
+
+TEST(pool_allocator) {
+    auto alloc = make_pool_memory_allocator();
+    auto * pool = &alloc.pool;
+
+    // NOTE(justas): rounded up to the class, aligned to it
+    auto a = memory_allocator_allocate(&alloc, 20, "a");
+    auto b = memory_allocator_allocate(&alloc, 20, "b");
+    assert(a.length == 32);
+    assert(((u64)a.data & 31) == 0);
+    assert((u8*)b.data == (u8*)a.data + 32);
+    assert(pool->num_slabs == 1);
+
+    // NOTE(justas): freed with a shorter length, like string_free does, still goes back to its class
+    a.length = 17;
+    memory_allocator_free(&alloc, a);
+    auto c = memory_allocator_allocate(&alloc, 30, "c");
+    assert(c.data == a.data);
+
+    auto wide = memory_allocator_allocate_aligned(&alloc, 8, CACHE_LINE_SIZE, "wide");
+    assert(((u64)wide.data & (CACHE_LINE_SIZE - 1)) == 0);
+    assert(pool->num_slabs == 2);
+
+    // NOTE(justas): lots of tiny strings and arrays, like a shader reload
+    auto arr = make_array<u64>(2, &alloc, "hashes"_S);
+    ForRange(index, 0, 5000) {
+        *array_append(&arr) = (u64)index;
+        auto str = make_string_copy("uniform name"_S, &alloc).string;
+        assert(string_equals(str, "uniform name"_S));
+        string_free(&alloc, &str);
+    }
+    assert(arr.storage[4999] == 4999);
+    assert(pool->large_allocations.watermark == 1);
+
+    array_free(&arr);
+    assert(pool->large_allocations.watermark == 0);
+
+    // NOTE(justas): not ours, left alone
+    auto literal = "static"_S;
+    string_free(&alloc, &literal);
+
+    memory_allocator_free(&alloc, b);
+    memory_allocator_free(&alloc, c);
+    memory_allocator_free(&alloc, wide);
+    assert(pool->num_live_slots == 0);
+
+    memory_allocator_allocate(&alloc, MEGABYTES(1), "leaked on purpose");
+    free_pool_memory_allocator(&alloc);
+    assert(pool->num_slabs == 0);
+}
+
+TEST(virtual_arena) {
+    auto alloc = make_virtual_arena_memory_allocator(GIGABYTES((s64)64), true);
+    auto * arena = &alloc.virt;
+    assert(arena->committed == 0);
+
+    auto arr = make_array<s64>(16, &alloc, "virtual arena test"_S);
+    auto * first = arr.storage;
+
+    ForRange(index, 0, 100000) {
+        *array_append(&arr) = index;
+    }
+
+    // NOTE(justas): grew to ~800KB without ever moving
+    assert(arr.storage == first);
+    assert(arr.storage[99999] == 99999);
+    assert(arena->committed >= 100000 * (s64)sizeof(s64));
+    assert(arena->committed % arena->commit_size == 0);
+
+    array_free(&arr);
+    assert(arena->top == 0);
+
+    memory_allocator_arena_reset(&alloc);
+    assert(arena->committed == arena->commit_size);
+
+    auto mem = memory_allocator_allocate(&alloc, 128, "after reset");
+    set_bytes((u8*)mem.data, 7, mem.length);
+    assert(mem.data == arena->reservation.data);
+
+    free_virtual_arena_memory_allocator(&alloc);
+}
+
+TEST(hash_xx64) {
+    assert(hash_xx64(empty_string) == 0xef46db3751d8e999UL);
+    assert(hash_xx64("abc"_S) == 0x44bc2cf5ad770999UL);
+    assert(hash_xx64("0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"_S) == 0x7639d419de614eedUL);
+
+    assert(hash_xx64("abc"_S, 1) != hash_xx64("abc"_S));
+}
+
 TEST(table) {
     auto table = make_table<s32>(4, &global_test_allocator, "test"_S);
     assert(table_get(&table, "one"_S) == 0);
@@ -6646,6 +8107,13 @@ TEST(table) {
 
         assert(*table_get(&table, str.string) == i);
     }
+
+    table_clear(&table);
+    assert(table.watermark == 0);
+    assert(table_get(&table, "one"_S) == 0);
+
+    *table_insert(&table, "one"_S) = 1;
+    assert(*table_get(&table, "one"_S) == 1);
 }
 
 TEST(string_splitting) {